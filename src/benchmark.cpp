@@ -0,0 +1,335 @@
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <new>
+#include <cstdlib>
+
+#include "benchmark.h"
+#include "power_diagram.h"
+#include "rasterizer.h"
+#include "interpolation.h"
+#include "mapping.h"
+#include "transport.h"
+#include "renderer.h"
+#include "image_writer.h"
+#include "lloyd.h"
+#include "sampler.h"
+#include "debug.h"
+
+// every allocation of the program goes through this operator new, so that
+// benchmark_solver_allocations can count those of the solver
+static std::atomic<long> nb_allocations(0);
+
+void *operator new(std::size_t size)
+{
+    nb_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size > 0 ? size : 1);
+    if(p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double time_diagram(const std::vector< std::pair<double, double> > &sites, const std::vector< double > &weights,
+                           double range, PowerBackend backend, int repeats, std::vector< int > &labels, int resolution)
+{
+    double best = 0;
+    for(int r = 0; r < repeats; r++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        PowerDiagram pd(sites, weights, range, range, backend);
+        double t = elapsed_ms(start);
+        if(r == 0 || t < best) best = t;
+
+        if(r == 0) {
+            Rasterizer rasterizer;
+            rasterizer.setup(pd, resolution, resolution);
+            labels.resize(resolution*resolution);
+            for(int y = 0; y < resolution; y++) {
+                rasterizer.rasterize_row(y, &labels[y*resolution]);
+            }
+        }
+    }
+    return best;
+}
+
+void benchmark_power_diagrams()
+{
+    const int resolution = 1024;
+    const double range = resolution;
+    const int sizes[] = {1000, 10000, 100000};
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> position(0., range);
+
+    const PowerBackend backends[] = {POWER_LIFTED, POWER_NATIVE, POWER_RADICAL};
+    const char *names[] = {"lifted", "native", "radical"};
+
+    std::cout << "sites\tbackend\ttime (ms)\tmismatched pixels" << std::endl;
+    for(int n : sizes) {
+        // weights of the order of the squared spacing between sites, as the
+        // transport solver produces
+        double spacing = range / sqrt((double)n);
+        std::uniform_real_distribution<double> weight(-spacing*spacing, spacing*spacing);
+
+        std::vector< std::pair<double, double> > sites(n);
+        std::vector< double > weights(n);
+        for(int i = 0; i < n; i++) {
+            sites[i] = std::make_pair(position(rng), position(rng));
+            weights[i] = weight(rng);
+        }
+
+        // the native backend is the reference labelling
+        PowerDiagram pd(sites, weights, range, range, POWER_NATIVE);
+        int repeats = (n >= 100000) ? 1 : 3;
+        std::vector< int > reference, labels;
+        time_diagram(sites, weights, range, POWER_NATIVE, 1, reference, resolution);
+        for(int k = 0; k < 3; k++) {
+            double t = time_diagram(sites, weights, range, backends[k], repeats, labels, resolution);
+
+            // pixels lying on a cell boundary may be given to either cell
+            int mismatched = 0;
+            for(int y = 0; y < resolution; y++) {
+                for(int x = 0; x < resolution; x++) {
+                    int a = reference[y*resolution + x], b = labels[y*resolution + x];
+                    if(a != b && std::abs(pd.power(a, x, y) - pd.power(b, x, y)) > 1e-6) mismatched++;
+                }
+            }
+
+            std::cout << n << "\t" << names[k] << "\t" << t << "\t" << mismatched << std::endl;
+        }
+    }
+}
+
+void benchmark_debug_levels()
+{
+    // a dark disc fading into a white background
+    const int resolution = 256;
+    Image image(resolution, resolution, 1);
+    for(int y = 0; y < resolution; y++) {
+        for(int x = 0; x < resolution; x++) {
+            double r = std::hypot(x - resolution/2., y - resolution/2.) / (resolution/2.);
+            image.at(x, y) = std::min(1., r);
+        }
+    }
+
+    int saved_verbosity = verbosity, saved_artifacts = artifact_level;
+    verbosity = 0;
+
+    std::cout << "artifacts\tmapping passes\ttime (ms)" << std::endl;
+    for(int level : {0, 2}) {
+        artifact_level = level;
+        std::vector< std::pair<double, double> > sample;
+        std::vector< double > masses;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int passes;
+        {
+            // the time includes draining the images still queued
+            ImageWriter writer;
+            passes = lloyd_sampling(image, sample, masses, 1000, QuantizationSettings(), POWER_NATIVE, writer);
+        }
+        std::cout << level << "\t" << passes << "\t" << elapsed_ms(start) << std::endl;
+    }
+
+    verbosity = saved_verbosity;
+    artifact_level = saved_artifacts;
+}
+
+void benchmark_frame_sequence()
+{
+    const int resolution = 1024;
+    const int n = 2000;
+    const int nb_frames = 300;
+
+    Image image(resolution, resolution, 1);
+    for(int y = 0; y < resolution; y++) {
+        for(int x = 0; x < resolution; x++) {
+            image.at(x, y) = 0.5 + 0.5*sin(x*0.05)*cos(y*0.03);
+        }
+    }
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> position(0., resolution);
+    double spacing = resolution / sqrt((double)n);
+    std::uniform_real_distribution<double> weight(-spacing*spacing, spacing*spacing);
+    std::vector< std::pair<double, double> > sites(n);
+    std::vector< double > weights(n);
+    for(int i = 0; i < n; i++) {
+        sites[i] = std::make_pair(position(rng), position(rng));
+        weights[i] = weight(rng);
+    }
+
+    std::vector< double > times(nb_frames);
+    for(int k = 0; k < nb_frames; k++) {
+        times[k] = (k+1.) / nb_frames;
+    }
+
+    std::cout << "mode\tframes\tmapping passes\ttime (ms)" << std::endl;
+    for(bool incremental : {false, true}) {
+        FrameRenderer renderer(image, sites, resolution, resolution, POWER_NATIVE);
+        renderer.incremental = incremental;
+
+        double checksum = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        renderer.render(weights, times, [&checksum](int, Image &frame) {
+            #pragma omp atomic
+            checksum += frame.data[0];
+        });
+        std::cout << (incremental ? "coherent" : "full") << "\t" << nb_frames << "\t" << renderer.passes() << "\t" << elapsed_ms(start) << std::endl;
+    }
+}
+
+void benchmark_lloyd_methods()
+{
+    // dark blobs of various sizes on a white background
+    const int resolution = 512;
+    const int n = 2000;
+    const int nb_iterations = 100;
+    Image image(resolution, resolution, 1);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> position(0., resolution), size(10., 60.);
+    std::vector< double > blob_x(8), blob_y(8), blob_size(8);
+    for(int b = 0; b < 8; b++) {
+        blob_x[b] = position(rng);
+        blob_y[b] = position(rng);
+        blob_size[b] = size(rng);
+    }
+    for(int y = 0; y < resolution; y++) {
+        for(int x = 0; x < resolution; x++) {
+            double darkness = 0.02;
+            for(int b = 0; b < 8; b++) {
+                double r2 = ((x - blob_x[b])*(x - blob_x[b]) + (y - blob_y[b])*(y - blob_y[b])) / (blob_size[b]*blob_size[b]);
+                darkness += exp(-r2);
+            }
+            image.at(x, y) = 1 - std::min(1., darkness);
+        }
+    }
+
+    std::vector< double > density(resolution*resolution);
+    for(int id = 0; id < resolution*resolution; id++) {
+        density[id] = 1 - image.data[id];
+    }
+    std::vector< int > pixels;
+    sample_without_replacement(density, n, rng, pixels);
+    std::vector< std::pair<double, double> > initial(n);
+    for(int i = 0; i < n; i++) {
+        initial[i] = std::make_pair((double)(pixels[i] % resolution), (double)(pixels[i] / resolution));
+    }
+
+    const LloydMethod methods[] = {LLOYD_PLAIN, LLOYD_OVERRELAXED, LLOYD_ANDERSON};
+    const char *names[] = {"plain", "overrelaxed", "anderson"};
+
+    std::vector< double > final_energy(3);
+    std::vector< std::vector< double > > trace_energy(3), trace_time(3);
+    std::vector< std::vector< int > > trace_passes(3);
+    for(int k = 0; k < 3; k++) {
+        LloydSettings settings;
+        settings.method = methods[k];
+        settings.iterations = nb_iterations;
+
+        LloydQuantizer quantizer(image);
+        std::vector< std::pair<double, double> > sites = initial;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        quantizer.run(sites, settings, [&](int, const std::vector< std::pair<double, double> >&) {
+            trace_energy[k].push_back(quantizer.energy);
+            trace_time[k].push_back(elapsed_ms(start));
+            trace_passes[k].push_back(quantizer.passes);
+        });
+        final_energy[k] = quantizer.energy;
+    }
+
+    std::cout << "method\titerations\tpasses\ttime (ms)\tenergy" << std::endl;
+    for(int k = 0; k < 3; k++) {
+        for(int iter = 0; iter < (int)trace_energy[k].size(); iter++) {
+            if(iter % 10 != 0 && iter+1 != (int)trace_energy[k].size()) continue;
+            std::cout << names[k] << "\t" << iter << "\t" << trace_passes[k][iter] << "\t" << trace_time[k][iter] << "\t" << trace_energy[k][iter] << std::endl;
+        }
+    }
+
+    // cost of reaching the energy plain Lloyd ends with, to within 0.1%
+    double target = final_energy[0] * 1.001;
+    std::cout << std::endl << "method\tpasses\ttime (ms) to reach energy " << target << std::endl;
+    for(int k = 0; k < 3; k++) {
+        int iter = 0;
+        while(iter < (int)trace_energy[k].size() && trace_energy[k][iter] > target) iter++;
+        if(iter == (int)trace_energy[k].size()) {
+            std::cout << names[k] << "\t-\t-" << std::endl;
+        } else {
+            std::cout << names[k] << "\t" << trace_passes[k][iter] << "\t" << trace_time[k][iter] << std::endl;
+        }
+    }
+}
+
+bool benchmark_solver_allocations()
+{
+    const int resolution = 256;
+    const int n = 1000;
+    // the buffers reach their size during the first steps
+    const int warmup = 3;
+    const int nb_steps = 12;
+
+    Image image(resolution, resolution, 1);
+    for(int y = 0; y < resolution; y++) {
+        for(int x = 0; x < resolution; x++) {
+            image.at(x, y) = 0.5 + 0.4*sin(x*0.05)*cos(y*0.03);
+        }
+    }
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> position(0., resolution);
+    std::vector< std::pair<double, double> > sites(n);
+    for(int i = 0; i < n; i++) {
+        sites[i] = std::make_pair(position(rng), position(rng));
+    }
+
+    const PowerBackend backends[] = {POWER_NATIVE, POWER_LIFTED, POWER_RADICAL};
+    const char *names[] = {"native", "lifted", "radical"};
+
+    bool allocation_free = true;
+    std::cout << "backend	step	allocations" << std::endl;
+    for(int k = 0; k < 3; k++) {
+        // the solver moves the Voronoi cells towards equal masses
+        std::vector< double > weights(n, 0.);
+        PowerDiagram *pd = new PowerDiagram(sites, weights, resolution, resolution, backends[k]);
+        PowerDiagram *trial = new PowerDiagram(sites, weights, resolution, resolution, backends[k]);
+        MappingWorkspace ws(resolution, resolution, n);
+        NewtonWorkspace newton;
+        generate_mapping(image, *pd, ws, MAPPING_MASSES | MAPPING_INCREMENTAL);
+        std::vector< double > masses = ws.site_weight;
+
+        double total = 0.;
+        for(double m : masses) {
+            total += m;
+        }
+        std::vector< double > target_masses(n, total / n);
+        double min_mass = std::min(*std::min_element(masses.begin(), masses.end()), total / n) / 2;
+
+        for(int step = 0; step < nb_steps; step++) {
+            long before = nb_allocations.load();
+            bool accepted = newton_step(image, target_masses, min_mass, pd, trial, ws, newton, masses);
+            long allocations = nb_allocations.load() - before;
+
+            std::cout << names[k] << "\t" << step << "\t" << allocations << std::endl;
+            if(step >= warmup && allocations > 0) allocation_free = false;
+            if(!accepted) break;
+        }
+
+        delete pd;
+        delete trial;
+    }
+
+    std::cout << (allocation_free ? "no allocation" : "allocations") << " after " << warmup << " steps" << std::endl;
+    return allocation_free;
+}
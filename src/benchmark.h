@@ -0,0 +1,25 @@
+#ifndef benchmark_h_INCLUDED
+#define benchmark_h_INCLUDED
+
+/* Times the construction of power diagrams of random sites with each
+   backend, and checks that the backends agree on the owner of every pixel */
+void benchmark_power_diagrams();
+
+/* Runs the Lloyd quantization of a synthetic image with and without the
+   debugging artifacts, and reports the mapping passes and time each takes */
+void benchmark_debug_levels();
+
+/* Renders a long interpolation sequence with and without carrying the
+   labels from one frame to the next, and reports the time each takes */
+void benchmark_frame_sequence();
+
+/* Quantizes a clustered synthetic image with each Lloyd method from the
+   same initial sites, and reports the energy against the passes and time */
+void benchmark_lloyd_methods();
+
+/* Runs damped Newton steps of the transport solver with each backend and
+   counts the heap allocations each step makes; returns false if a step
+   past the first ones allocates */
+bool benchmark_solver_allocations();
+
+#endif // benchmark_h_INCLUDED
@@ -0,0 +1,4 @@
+#include "debug.h"
+
+int verbosity = 1;
+int artifact_level = 1;
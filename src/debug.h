@@ -0,0 +1,13 @@
+#ifndef debug_h_INCLUDED
+#define debug_h_INCLUDED
+
+/* What gets printed: 0 only errors and the final summary, 1 the progress
+   of the computations (default), 2 also debugging traces */
+extern int verbosity;
+
+/* What gets written to disk: 0 no image, 1 the interpolation frames
+   (default), 2 also the debugging images of the Lloyd iterations. Images
+   of a disabled level are not even computed */
+extern int artifact_level;
+
+#endif // debug_h_INCLUDED
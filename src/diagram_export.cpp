@@ -0,0 +1,124 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "diagram_export.h"
+
+static void write_gnuplot(const PowerDiagram &pd, std::ofstream &file)
+{
+    for(int i = 0; i < pd.nb_sites; i++) {
+        const std::vector< std::pair<double, double> > &polygon = pd.sites_edges[i];
+        if(polygon.empty()) continue;
+        for(const std::pair<double, double> &v : polygon) {
+            file << v.first << " " << v.second << "\n";
+        }
+        file << polygon[0].first << " " << polygon[0].second << "\n\n";
+    }
+}
+
+// writes the bytes of value least significant first, whatever the byte
+// order of the host
+template <typename T>
+static void write_value(std::ofstream &file, T value)
+{
+    typedef typename std::conditional<sizeof(T) == 8, uint64_t, uint32_t>::type bits_type;
+    static_assert(sizeof(T) == sizeof(bits_type), "only 32 and 64 bit values are written");
+
+    bits_type bits;
+    memcpy(&bits, &value, sizeof(T));
+    char bytes[sizeof(T)];
+    for(int k = 0; k < (int)sizeof(T); k++) {
+        bytes[k] = (char)((bits >> (8*k)) & 0xff);
+    }
+    file.write(bytes, sizeof(T));
+}
+
+static void write_binary(const PowerDiagram &pd, std::ofstream &file)
+{
+    file.write("PDG1", 4);
+    write_value<int32_t>(file, pd.nb_sites);
+    write_value<double>(file, pd.x_range);
+    write_value<double>(file, pd.y_range);
+    for(int i = 0; i < pd.nb_sites; i++) {
+        const std::vector< std::pair<double, double> > &polygon = pd.sites_edges[i];
+        write_value<double>(file, pd.sites[i].first);
+        write_value<double>(file, pd.sites[i].second);
+        write_value<double>(file, pd.weights[i]);
+        write_value<int32_t>(file, polygon.size());
+        for(const std::pair<double, double> &v : polygon) {
+            write_value<double>(file, v.first);
+            write_value<double>(file, v.second);
+        }
+        for(int j : pd.sites_neighbors[i]) {
+            write_value<int32_t>(file, j);
+        }
+    }
+}
+
+static void write_svg(const PowerDiagram &pd, std::ofstream &file)
+{
+    file << "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"0 0 " << pd.x_range << " " << pd.y_range << "\">\n";
+    file << "<g fill=\"none\" stroke=\"black\" stroke-width=\"0.2\">\n";
+    for(int i = 0; i < pd.nb_sites; i++) {
+        if(pd.sites_edges[i].empty()) continue;
+        file << "<polygon points=\"";
+        for(const std::pair<double, double> &v : pd.sites_edges[i]) {
+            file << v.first << "," << v.second << " ";
+        }
+        file << "\"/>\n";
+    }
+    file << "</g>\n<g fill=\"red\">\n";
+    for(int i = 0; i < pd.nb_sites; i++) {
+        file << "<circle cx=\"" << pd.sites[i].first << "\" cy=\"" << pd.sites[i].second << "\" r=\"0.5\"/>\n";
+    }
+    file << "</g>\n</svg>\n";
+}
+
+bool parse_diagram_format(const std::string &name, DiagramFormat &format)
+{
+    if(name == "none") {
+        format = DIAGRAM_NONE;
+    } else if(name == "gnuplot") {
+        format = DIAGRAM_GNUPLOT;
+    } else if(name == "binary") {
+        format = DIAGRAM_BINARY;
+    } else if(name == "svg") {
+        format = DIAGRAM_SVG;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int export_diagram(const PowerDiagram &pd, DiagramFormat format, const std::string &file_name)
+{
+    if(format == DIAGRAM_NONE) return 0;
+
+    std::ofstream file(file_name, std::ios::out | std::ios::binary);
+    if(!file) {
+        std::cerr << "Cannot open " << file_name << " to export the diagram" << std::endl;
+        return 1;
+    }
+
+    if(format == DIAGRAM_GNUPLOT) {
+        write_gnuplot(pd, file);
+    } else if(format == DIAGRAM_BINARY) {
+        write_binary(pd, file);
+    } else {
+        write_svg(pd, file);
+    }
+
+    return file ? 0 : 1;
+}
+
+void export_iteration(const PowerDiagram &pd, const DiagramExport &exporter, int iter)
+{
+    if(exporter.format == DIAGRAM_NONE || exporter.interval <= 0 || iter % exporter.interval != 0) return;
+
+    const char *extension = (exporter.format == DIAGRAM_GNUPLOT) ? "gnu" : (exporter.format == DIAGRAM_BINARY) ? "bin" : "svg";
+    export_diagram(pd, exporter.format, exporter.prefix + "_iter_" + std::to_string(iter) + "." + extension);
+}
@@ -0,0 +1,41 @@
+#ifndef diagram_export_h_INCLUDED
+#define diagram_export_h_INCLUDED
+
+#include <string>
+
+#include "power_diagram.h"
+
+enum DiagramFormat
+{
+    DIAGRAM_NONE,
+    // one closed polyline per cell, cells separated by blank lines, to be
+    // drawn with gnuplot's "plot 'file' with lines"
+    DIAGRAM_GNUPLOT,
+    // little-endian dump: "PDG1", int32 nb_sites, double x_range, y_range,
+    // then for every site double x, y, weight, int32 nb_vertices, the
+    // vertices as pairs of doubles and the int32 neighbours of the edges
+    DIAGRAM_BINARY,
+    // the cells as polygons over the domain, and the sites as dots
+    DIAGRAM_SVG
+};
+
+/* Which diagrams of the weight optimisation are written to disk: those of
+   the iterations multiple of interval, none by default */
+struct DiagramExport
+{
+    DiagramFormat format = DIAGRAM_NONE;
+    int interval = 1;
+    std::string prefix = "debug_imgs/diagram";
+};
+
+/* Parses "none", "gnuplot", "binary" or "svg", returns false for other names */
+bool parse_diagram_format(const std::string &name, DiagramFormat &format);
+
+/* Writes the cells of pd to file_name, returns 0 on success */
+int export_diagram(const PowerDiagram &pd, DiagramFormat format, const std::string &file_name);
+
+/* Writes the diagram of the iteration iter to <prefix>_iter_<iter>.<ext> if
+   exporting is enabled and iter is a multiple of the interval */
+void export_iteration(const PowerDiagram &pd, const DiagramExport &exporter, int iter);
+
+#endif // diagram_export_h_INCLUDED
@@ -6,7 +6,6 @@
 #include "stb_image.h"
 #include "stb_image_write.h"
 
-#include "pixel.h"
 #include "image.h"
 
 #define linearize_rgb(x) (x <= 0.04045 ? x / 12.92 : pow((x+0.055)/1.055, 2.4))
@@ -26,15 +25,7 @@ Image::Image(int h, int w, int c)
     width = w;
     color = c;
 
-    data = std::vector<std::vector<Pixel>>(h, std::vector<Pixel>(w, Pixel(c)));
-}
-
-Image::Image(std::vector< std::vector<Pixel> > d, int h, int w, int c)
-{
-    data = d;
-    height = h;
-    width = w;
-    color = c;
+    data.assign(c*h*w, 0.);
 }
 
 int Image::load_from_file(std::string file_name)
@@ -51,23 +42,17 @@ int Image::load_from_file(std::string file_name)
         return 1;
     }
 
-    std::vector<std::vector<Pixel>> d = std::vector<std::vector<Pixel>>(h, std::vector<Pixel>(w, Pixel(c)));
-
-    for(int i = 0; i < h; i++) {
-        for(int j = 0; j < w; j++) {
-            int id = 3*(i*w + j);
-            double r = (double)image_data[id]/255;
-            double g = (double)image_data[id+1]/255;
-            double b = (double)image_data[id+2]/255;
-            d[i][j] = Pixel({r,g,b});
-
-        }
-    }
-
     height = h;
     width = w;
-    data = d;
     color = 3;
+    data.resize(3*h*w);
+
+    for(int c = 0; c < 3; c++) {
+        double *plane = channel(c);
+        for(int id = 0; id < h*w; id++) {
+            plane[id] = (double)image_data[3*id + c]/255;
+        }
+    }
 
     stbi_image_free(image_data);
     return 0;
@@ -80,24 +65,25 @@ void Image::convert_to_grayscale()
         return;
     }
 
-    std::vector< std::vector<Pixel> > new_data = std::vector<std::vector<Pixel>>(height, std::vector<Pixel>(width, Pixel(0.0)));
+    // the gray plane overwrites the red one in place, then the other planes are dropped
+    double *gs_plane = channel(0);
+    const double *r_plane = channel(0);
+    const double *g_plane = channel(1);
+    const double *b_plane = channel(2);
 
-    for(int i = 0; i < height; i++) {
-        for(int j = 0; j < width; j++) {
+    for(int id = 0; id < height*width; id++) {
+        double r = linearize_rgb(r_plane[id]);
+        double g = linearize_rgb(g_plane[id]);
+        double b = linearize_rgb(b_plane[id]);
 
-            double r = linearize_rgb(data[i][j].r());
-            double g = linearize_rgb(data[i][j].g());
-            double b = linearize_rgb(data[i][j].b());
-
-            new_data[i][j] = Pixel(gamma_compress_gs(0.2126*r + 0.7152*g + 0.0722*b));
-        }
+        gs_plane[id] = gamma_compress_gs(0.2126*r + 0.7152*g + 0.0722*b);
     }
 
-    data = new_data;
+    data.resize(height*width);
     color = 1;
 }
 
-int Image::save_to_file(std::string file_name)
+int Image::save_to_file(std::string file_name) const
 {
     unsigned char* image = new unsigned char[height*width*3];
     for(int i = 0; i < height; i++) {
@@ -105,9 +91,9 @@ int Image::save_to_file(std::string file_name)
             int id = 3*(i*width + j);
             
             if(color == 3) {
-                double r_d = data[i][j].r();
-                double g_d = data[i][j].g();
-                double b_d = data[i][j].b();
+                double r_d = at(j, i, 0);
+                double g_d = at(j, i, 1);
+                double b_d = at(j, i, 2);
 
                 int r = clamp((int)(255. * r_d));
                 int g = clamp((int)(255. * g_d));
@@ -117,7 +103,7 @@ int Image::save_to_file(std::string file_name)
                 image[id+1] = g;
                 image[id+2] = b;
             } else if(color == 1) {
-                double gs_d = data[i][j].gs();
+                double gs_d = gs(j, i);
 
                 int gs = clamp((int)(255. * gs_d));
                 
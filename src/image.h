@@ -2,26 +2,63 @@
 #define image_h_INCLUDED
 
 #include <vector>
+#include <string>
+#include <cstdlib>
+#include <new>
 
-#include "pixel.h"
+/* Allocator returning blocks aligned on Alignment bytes, so that rows of an
+   image can be loaded with wide vector instructions */
+template <typename T, std::size_t Alignment = 64>
+struct AlignedAllocator
+{
+    typedef T value_type;
+
+    template <typename U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+    AlignedAllocator() {}
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T *allocate(std::size_t n)
+    {
+        void *p = NULL;
+        if(posix_memalign(&p, Alignment, n * sizeof(T)) != 0) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T *p, std::size_t) { free(p); }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U, Alignment> &) const { return false; }
+};
 
 class Image
 {
     public:
-        std::vector< std::vector<Pixel>> data;
+        // planar storage: the channel c of the pixel (x, y) is stored at
+        // data[(c*height + y)*width + x]; gray-scaled images have one channel
+        std::vector< double, AlignedAllocator<double> > data;
         int height;
         int width;
         int color;
 
         Image();
         Image(int h, int w, int color);
-        Image(std::vector< std::vector<Pixel> > data, int h, int w, int color);
+
+        double *channel(int c) { return &data[c*height*width]; }
+        const double *channel(int c) const { return &data[c*height*width]; }
+
+        double *row(int y, int c = 0) { return &data[(c*height + y)*width]; }
+        const double *row(int y, int c = 0) const { return &data[(c*height + y)*width]; }
+
+        double &at(int x, int y, int c = 0) { return data[(c*height + y)*width + x]; }
+        double at(int x, int y, int c = 0) const { return data[(c*height + y)*width + x]; }
+
+        double gs(int x, int y) const { return at(x, y, 0); }
 
         void convert_to_grayscale();
-        
+
         int load_from_file(std::string file_name);
-        int save_to_file(std::string file_name);
+        int save_to_file(std::string file_name) const;
 };
 
 #endif // image_h_INCLUDED
-
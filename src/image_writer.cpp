@@ -0,0 +1,55 @@
+#include <algorithm>
+
+#include "image_writer.h"
+
+ImageWriter::ImageWriter(int c)
+{
+    capacity = std::max(c, 1);
+    stopping = false;
+    worker = std::thread(&ImageWriter::run, this);
+}
+
+ImageWriter::~ImageWriter()
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        stopping = true;
+    }
+    queue_changed.notify_all();
+    worker.join();
+}
+
+void ImageWriter::submit(const std::string &file_name, Image image)
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    // only the last image submitted for a path is worth writing
+    for(std::pair<std::string, Image> &pending : queue) {
+        if(pending.first == file_name) {
+            pending.second = std::move(image);
+            return;
+        }
+    }
+
+    queue_changed.wait(guard, [this]{ return (int)queue.size() < capacity; });
+    queue.push_back(std::make_pair(file_name, std::move(image)));
+    queue_changed.notify_all();
+}
+
+void ImageWriter::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    for(;;) {
+        queue_changed.wait(guard, [this]{ return stopping || !queue.empty(); });
+        // the queue is drained before stopping
+        if(queue.empty()) return;
+
+        std::pair<std::string, Image> job = std::move(queue.front());
+        queue.pop_front();
+        queue_changed.notify_all();
+
+        guard.unlock();
+        job.second.save_to_file(job.first);
+        guard.lock();
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef image_writer_h_INCLUDED
+#define image_writer_h_INCLUDED
+
+#include <string>
+#include <deque>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "image.h"
+
+/* Saves images to disk from a background thread, so that the PNG encoding
+   and the file system never stall the computations. At most capacity
+   images wait in the queue, submit() blocks beyond that; an image queued
+   for a path already waiting to be written replaces the older one */
+class ImageWriter
+{
+    public:
+        ImageWriter(int capacity = 16);
+        ~ImageWriter();
+
+        void submit(const std::string &file_name, Image image);
+
+    private:
+        int capacity;
+        bool stopping;
+        std::deque< std::pair<std::string, Image> > queue;
+        std::mutex lock;
+        std::condition_variable queue_changed;
+        std::thread worker;
+
+        void run();
+};
+
+#endif // image_writer_h_INCLUDED
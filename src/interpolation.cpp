@@ -5,6 +5,10 @@
 #include <random>
 #include <algorithm>
 #include <fstream>
+#include <cmath>
+#include <chrono>
+#include <map>
+#include <mutex>
 
 #include "../libs/include/voro++/voro++.hh"
 
@@ -12,65 +16,37 @@
 
 #include "interpolation.h"
 #include "power_diagram.h"
-
-#define DEBUG 1
-
-void generate_mapping(Image image, voro::container &container, std::vector< std::vector<int> > &pix_to_site, std::vector< std::vector<std::pair<double, double> > > &pix_to_coord, std::vector< std::vector< std::pair<int, int> > > &site_to_pix, std::vector<double> &site_weight, int N)
+#include "mapping.h"
+#include "transport.h"
+#include "image_writer.h"
+#include "renderer.h"
+#include "sequence_writer.h"
+#include "sampler.h"
+#include "lloyd.h"
+#include "multiscale.h"
+#include "debug.h"
+
+void generate_image_from_container(const Image &image, const PowerDiagram &pd, MappingWorkspace &ws, ImageWriter &writer, const std::string &name)
 {
-    if(DEBUG) std::cout << "Generate a mapping..." << std::endl;
+    Image quantized = Image(image.height, image.width, 1);
 
-    int width = image.width;
-    int height = image.height;
+    generate_mapping(image, pd, ws, MAPPING_LABELS | MAPPING_MASSES);
 
-    pix_to_site = std::vector< std::vector<int> > (width, std::vector<int>(height, -1));
-    pix_to_coord = std::vector< std::vector<std::pair<double, double> > > (width, std::vector< std::pair<double,double> >(height));
-    site_to_pix = std::vector< std::vector< std::pair<int, int> > > (N);
-    site_weight = std::vector< double >(N, 0);
-
-    for(int x = 0; x < image.width; x++) {
-        for(int y = 0; y < image.height; y++) {
-            double rx, ry, rz;
-            int site_id;            
-            if(container.find_voronoi_cell((double)x,double(y),0., rx, ry, rz, site_id)) {
-                pix_to_site[x][y] = site_id;
-                pix_to_coord[x][y] = std::make_pair(rx, ry); 
-                site_to_pix[site_id].push_back(std::make_pair(x,y));
-                site_weight[site_id] += image.data[x][y].gs(); 
-            } else {
-                std::cout << " ERROR CASE in generate_mapping" << std::endl;
-            }
-        }
+    double *out = quantized.channel(0);
+    for(int id = 0; id < image.width*image.height; id++) {
+        int site = ws.pix_to_site[id];
+        out[id] = ws.site_weight[site]/ws.site_count[site];
     }
-}
-
-void generate_image_from_container(Image image, voro::container &container, std::string name, int N)
-{
-    Image quantized = image;
 
-    std::vector< std::vector<int> > pix_to_site; 
-    std::vector< std::vector<std::pair<double, double> > > pix_to_coord; 
-    std::vector< std::vector< std::pair<int, int> > > site_to_pix;  
-    std::vector< double > site_weight;
-    generate_mapping(image, container, pix_to_site, pix_to_coord, site_to_pix, site_weight, N);
-
-
-
-    for(int x = 0; x < image.width; x++) {
-        for(int y = 0; y < image.height; y++) {
-            int site = pix_to_site[x][y];
-            quantized.data[x][y] = Pixel(site_weight[site]/site_to_pix[site].size());//Pixel(image.data[x_site][y_site].gs());
-        }
-    }
-
-    quantized.save_to_file(name);
+    writer.submit(name, std::move(quantized));
 }
 
 
-// receives a gray-scaled image, and performs rejection sampling on it,
-// returns a cloud of N points
-void sampling_from_measure(Image image, std::vector< std::pair<double, double> > &sample, int N)    
+// receives a gray-scaled image, and samples N distinct pixels from the
+// density 1-gray, returns a cloud of N points
+void sampling_from_measure(const Image &image, std::vector< std::pair<double, double> > &sample, int N, const QuantizationSettings &quantization)
 {
-    std::cout << "Performing initial rejection sampling on target image..." << std::endl;
+    if(verbosity >= 1) std::cout << "Performing initial sampling on target image..." << std::endl;
     int width = image.width;
     int height = image.height;
 
@@ -78,136 +54,141 @@ void sampling_from_measure(Image image, std::vector< std::pair<double, double> >
 
     // setup randomness
     std::random_device dev;
-    std::mt19937 rng(dev());
-    std::uniform_int_distribution<std::mt19937::result_type> dist_row(0, height-1); // distribution in range [1, 6]
-    std::uniform_int_distribution<std::mt19937::result_type> dist_col(0, width-1);
-
-    std::uniform_real_distribution<> dist_unif(0, 1);
+    std::mt19937 rng(quantization.seed != 0 ? quantization.seed : dev());
 
-    // compute normalization scalar
-    double normalization = 0.;
-    for(int x = 0; x < width; x++) {
-        for(int y = 0; y < height; y++) {
-            normalization += (1-image.data[x][y].gs());
-        }
+    // the grayscale defines a distribution on the image
+    std::vector< double > density(width*height);
+    const double *gs = image.channel(0);
+    for(int id = 0; id < width*height; id++) {
+        density[id] = std::max(0., 1-gs[id]);
     }
 
-    int sampled = 0;
-    while(sampled < N) {
-        int x = dist_col(rng); 
-        int y = dist_row(rng);
-        double u = dist_unif(rng);
-
-        // the grayscale defines a distribution on the image
-        // since 0 < rho(p) <= 1 we have rho(p) <= nb_pixel * density_unif_pixel(p)
-        // so we need to check whether u < rho(p)
-
-        if(u <= (1-image.data[x][y].gs())/normalization) {
-            bool already_found = (std::find(sample.begin(), sample.end(), std::make_pair((double)x,(double)y)) != sample.end());
-            if(!already_found) {
+    std::vector< int > pixels;
+    if(quantization.sampling == SAMPLING_STRATIFIED) {
+        sample_stratified(density, width, height, N, rng, pixels);
+    } else {
+        AliasTable table(density);
+        std::vector< bool > occupied(width*height, false);
+        int rejected = 0;
+        while((int)pixels.size() < N && rejected <= 4*N) {
+            int id = table.sample(rng);
+            if(!occupied[id]) {
                 // accept the pixel
-                sample.push_back(std::make_pair((double)x,(double)y));
-                sampled++;
+                occupied[id] = true;
+                pixels.push_back(id);
+            } else {
+                rejected++;
             }
         }
+
+        // the pixels already taken hold most of the mass, rejecting them
+        // would stall: draw the whole sample without replacement instead
+        if((int)pixels.size() < N) {
+            sample_without_replacement(density, N, rng, pixels);
+        }
+    }
+
+    for(int id : pixels) {
+        sample.push_back(std::make_pair((double)(id % width), (double)(id / width)));
     }
 }
 
-void lloyd_sampling(Image image, std::vector< std::pair<double, double> >&sample, std::vector< double > &masses, int N)
+int lloyd_sampling(const Image &image, std::vector< std::pair<double, double> >&sample, std::vector< double > &masses, int N, const QuantizationSettings &quantization, PowerBackend backend, ImageWriter &writer)
 {
-    int height = image.height;
-    int width = image.width;
+    sampling_from_measure(image, sample, N, quantization);
+    
+    if(verbosity >= 1) std::cout << "Performs Lloyd iterations to properly quantize the target image..." << std::endl; 
 
-    int max_iter = 10;
+    LloydQuantizer quantizer(image, backend);
+    MappingWorkspace ws;
 
-    sampling_from_measure(image, sample, N);
-    
-    std::cout << "Performs Lloyd iterations to properly quantize the target image..." << std::endl; 
+    int iterations = quantizer.run(sample, quantization.lloyd, [&](int iter, const std::vector< std::pair<double, double> > &sites) {
+        if(verbosity >= 1 && iter % 5 == 0) std::cout << "Lloyd iteration " << iter << ", energy " << quantizer.energy << std::endl;
+        if(artifact_level < 2) return;
 
-    for(int iter = 0; iter < max_iter; iter++) {
         Image evolution = image;
+        for(int i = 0; i < N; i ++) {
+            int x_id = floor(sites[i].first);
+            int y_id = floor(sites[i].second);
+            evolution.at(x_id, y_id) = 1.;
+        }
 
-        if(iter % 5 == 0) std::cout << "Lloyd iteration " << iter << std::endl;
-
-        if(DEBUG) {
-            for(int i = 0; i < N; i ++) {
-                char* name = new char[100];
+        char* name = new char[100];
+        sprintf(name, "debug_imgs/lloyd_iter_%d.png", iter); 
+        writer.submit(name, std::move(evolution));
 
-                int x_id = floor(sample[i].first);
-                int y_id = floor(sample[i].second);
-                evolution.data[x_id][y_id] = Pixel(1.);
+        sprintf(name, "debug_imgs/lloyd_mapped_iter_%d.png", iter); 
+        generate_image_from_container(image, quantizer.diagram(), ws, writer, name);
+        delete[] name;
+    });
 
-                sprintf(name, "debug_imgs/lloyd_iter_%d.png", iter); 
+    // the masses are those of the final diagram
+    masses = quantizer.site_weight;
+    if(verbosity >= 1) std::cout << "Lloyd iterations stopped after " << iterations << " iterations, energy " << quantizer.energy << std::endl;
 
-                evolution.save_to_file(name);
+    // the debug images of the cells are mapped with ws, count them as well
+    return quantizer.passes + ws.passes;
+}
 
-                delete[] name;
-            }
-        }
-       
-        voro::container container(0, width, 0, height, -0.5, 0.5, 1, 1, 1, false, false, false, N);        
-        for(int i = 0; i < N; i++) {
-            container.put(i, sample[i].first, sample[i].second, 0.);
-        }
+double compute_total_mass(const Image &image)
+{
+    double mass = 0.;
+    const double *gs = image.channel(0);
+    for(int id = 0; id < image.width*image.height; id++) {
+        mass += gs[id];
+    }
+    return mass;
+}
 
-        // iterate over all cells
-        voro::c_loop_all cla(container);
-        voro::voronoicell c;
-
-        std::vector< std::vector<int> > pix_to_site; 
-        std::vector< std::vector<std::pair<double, double> > > pix_to_coord; 
-        std::vector< std::vector< std::pair<int, int> > > site_to_pix;  
-        std::vector< double > site_weight;
-
-        generate_mapping(image, container, pix_to_site, pix_to_coord, site_to_pix, site_weight, N);
-        for(int id = 0; id < N; id++) {
-            double centr_x = 0., centr_y = 0.;
-            double negative_weight = 0.;
-
-            for(std::pair<int, int> p : site_to_pix[id]) {
-                double density = image.data[p.first][p.second].gs();
-                negative_weight += 1-density;
-                centr_x += (double)p.first * (1-density);
-                centr_y += (double)p.second * (1-density);
-            }
-            sample[id] = std::make_pair(centr_x/negative_weight, centr_y/negative_weight);
-        }
+// renders the interpolation between the source image (t = 0) and the
+// transported one (t = 1) at interoplation_steps-1 intermediate times
+static void render_interpolation(FrameRenderer &renderer, DisplacementRenderer &displacement, const PowerDiagram &pd, RenderMode mode, int iter, int interoplation_steps, ImageWriter &writer, SequenceWriter *sequence)
+{
+    if(verbosity >= 1) std::cout << "Generating the interpolation at step " << iter << std::endl;
 
+    std::vector< double > times;
+    for(int t = 1; t < interoplation_steps; t++) {
+        times.push_back((double)t/(double)interoplation_steps);
+    }
 
-        if(DEBUG) {
-            char* name = new char[100];
-            sprintf(name, "debug_imgs/lloyd_mapped_iter_%d.png", iter); 
-            generate_image_from_container(image, container, name, N);
-            delete[] name;
+    // the frames are handed to the writer as they are produced, a sequence
+    // needs them in order so those rendered ahead wait in pending
+    std::mutex lock;
+    std::map< int, Image > pending;
+    int next_frame = 0;
+    auto consume = [&](int k, Image &frame) {
+        if(sequence == NULL) {
+            char name[100];
+            sprintf(name, "debug_imgs/grad_iter_%d_inter_%d.png", iter, k+1);
+            writer.submit(name, std::move(frame));
+            return;
         }
 
-        if(iter+1 == max_iter) {
-            std::vector< std::vector<int> > pix_to_site; 
-            std::vector< std::vector<std::pair<double, double> > > pix_to_coord; 
-            std::vector< std::vector< std::pair<int, int> > > site_to_pix;  
-            std::vector< double > site_weight;
-            generate_mapping(image, container, pix_to_site, pix_to_coord, site_to_pix, masses, N);
+        std::lock_guard<std::mutex> guard(lock);
+        std::swap(pending[k], frame);
+        for(auto first = pending.begin(); first != pending.end() && first->first == next_frame; first = pending.begin()) {
+            sequence->append(first->second);
+            pending.erase(first);
+            next_frame++;
         }
-    }
-}
-
-double compute_total_mass(Image image)
-{
-    double mass = 0.;
-    for(int i = 0; i < image.width; i++) {
-        for(int j = 0; j < image.height; j++) {
-            mass += image.data[i][j].gs();
+    };
+
+    if(mode == RENDER_DISPLACEMENT) {
+        displacement.setup(pd);
+        for(int k = 0; k < (int)times.size(); k++) {
+            Image frame;
+            displacement.render(times[k], frame);
+            consume(k, frame);
         }
+    } else {
+        renderer.render(pd.weights, times, consume);
     }
-    return mass;
 }
 
-void interpolation(std::string source_image, std::string target_image, int N)
+void interpolation(std::string source_image, std::string target_image, int N, const StoppingCriteria &stopping, const QuantizationSettings &quantization, const MultiscaleSettings &multiscale, const RenderSettings &render, PowerBackend backend, const DiagramExport &exporter)
 {
-    N = 700;
-    double step = 1000.;
-    int interpolation_rate = 300;
-    int interoplation_steps = 10;
+    int interpolation_rate = render.interpolation_rate;
+    int interoplation_steps = render.interpolation_steps;
     Image source = Image();
     source.load_from_file(source_image);
     source.convert_to_grayscale();
@@ -220,60 +201,131 @@ void interpolation(std::string source_image, std::string target_image, int N)
 
     double target_total_mass = compute_total_mass(target);
 
+    if(N > target.width*target.height) {
+        std::cerr << "Cannot place " << N << " Diracs on the " << target.width*target.height << " pixels of the target image" << std::endl;
+        return;
+    }
+
+    // the debug images and the frames are encoded and written in the background
+    ImageWriter writer;
+    SequenceWriter *sequence = NULL;
+    if(render.sequence != SEQUENCE_PNG) {
+        sequence = new SequenceWriter(render.sequence, render.sequence_output, render.fps);
+        if(!sequence->is_open()) {
+            delete sequence;
+            return;
+        }
+    }
+
     std::vector< std::pair<double, double> >target_sample;
     std::vector< double > target_masses;
 
-    lloyd_sampling(target, target_sample, target_masses, N);
+    int lloyd_passes = lloyd_sampling(target, target_sample, target_masses, N, quantization, backend, writer);
 
     std::vector< double > weights(N, 10.);
+    int multiscale_passes = 0;
+    if(multiscale.levels > 0) {
+        multiscale_passes = multiscale_weights(source, target, target_sample, target_masses, multiscale, quantization.lloyd, backend, weights);
+    }
 
     std::ofstream outputFile("mse.txt");
 
-    for(int gradient_iter = 0; gradient_iter < 10000; gradient_iter++) {
-        PowerDiagram pd = PowerDiagram(target_sample, weights, (double)target.width, (double)target.height);
+    MappingWorkspace ws = MappingWorkspace(source.width, source.height, N);
+
+    double x_range = (double)target.width, y_range = (double)target.height;
+    // the sites never move, so the current diagram and the trial one of the
+    // line search are both updated in place and swapped on acceptance
+    PowerDiagram *pd = new PowerDiagram(target_sample, weights, x_range, y_range, backend);
+    PowerDiagram *trial = new PowerDiagram(target_sample, weights, x_range, y_range, backend);
+    generate_mapping(source, *pd, ws, MAPPING_MASSES | MAPPING_INCREMENTAL);
+    std::vector< double > masses = ws.site_weight;
+
+    // the damped Newton steps keep every cell at least this heavy
+    std::vector< double > scaled_target_masses(N);
+    double min_mass = *std::min_element(masses.begin(), masses.end());
+    for(int p = 0; p < N; p++) {
+        scaled_target_masses[p] = target_masses[p]/target_total_mass*source_total_mass;
+        min_mass = std::min(min_mass, scaled_target_masses[p]);
+    }
+    min_mass /= 2;
+
+    FrameRenderer renderer(source, target_sample, x_range, y_range, backend);
+    DisplacementRenderer displacement(source);
 
-        std::vector< std::vector<int> > pix_to_site; 
-        std::vector< std::vector<std::pair<double, double> > > pix_to_coord; 
-        std::vector< std::vector< std::pair<int, int> > > site_to_pix;  
-        std::vector< double > site_weight;
-        generate_mapping(source, *pd.container, pix_to_site, pix_to_coord, site_to_pix, site_weight, N);
+    NewtonWorkspace newton;
+    std::vector< double > gradient(N);
+    int gradient_iter = 0;
+    int last_render = -1;
+    double previous_mse = -1;
+    std::string stop_reason = "iteration cap reached";
 
-        std::vector< double > gradient(N,0);
-        double mse = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for(; gradient_iter < stopping.max_iter; gradient_iter++) {
+        double mse = 0, residual = 0;
         for(int p = 0; p < N; p++) {
-            gradient[p] = target_masses[p]/target_total_mass - site_weight[p]/source_total_mass;
+            gradient[p] = target_masses[p]/target_total_mass - masses[p]/source_total_mass;
             mse += (gradient[p]*gradient[p])/N;
-            weights[p] = weights[p]+step*gradient[p];//std::max(1e-4, weights[p] + step * gradient[p]);
+            residual = std::max(residual, fabs(gradient[p]));
         }
-        if(DEBUG) {
-            std::cout << "grad : " << gradient[0] << " " << gradient[20] << std::endl;
-            std::cout << "weight : " << weights[0] << " " << weights[20] << std::endl;
+        if(verbosity >= 2) {
+            std::cout << "grad : " << gradient[0] << " " << gradient[N-1] << std::endl;
+            std::cout << "weight : " << pd->weights[0] << " " << pd->weights[N-1] << std::endl;
         }
 
-        if(gradient_iter % interpolation_rate == 0) {
-            char* name = new char[100];
-            for(int t = 1; t < interoplation_steps; t++) {
-                sprintf(name, "debug_imgs/grad_iter_%d_inter_%d.png", gradient_iter, t); 
-                std::cout << "Generating interpolation at step " << gradient_iter << ", at " << 100.*(double)t/(double)interoplation_steps << "%" << std::endl;
-
-                std::vector< double > weights_interp(N, 0.);
-                for(int s = 0; s < N; s++) {
-                    weights_interp[s] = ((double)t/(double)interoplation_steps)*weights[s];
-                }
+        export_iteration(*pd, exporter, gradient_iter);
 
-                PowerDiagram pd = PowerDiagram(target_sample, weights_interp, (double)target.width, (double)target.height);
-                generate_image_from_container(source, *pd.container, name, N);
-            }
-
-            delete[] name;
+        if(artifact_level >= 1 && gradient_iter % interpolation_rate == 0) {
+            render_interpolation(renderer, displacement, *pd, render.mode, gradient_iter, interoplation_steps, writer, sequence);
+            last_render = gradient_iter;
         }
         
-        std::cout << gradient_iter << "; " << mse << std::endl;
+        if(verbosity >= 1) std::cout << gradient_iter << "; " << mse << std::endl;
         outputFile << gradient_iter << "; " << mse << std::endl;
 
-        // perform update
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(residual * N <= stopping.residual_tolerance) {
+            stop_reason = "mass residual below tolerance";
+            break;
+        }
+        if(stopping.mse_tolerance > 0 && mse <= stopping.mse_tolerance) {
+            stop_reason = "mse below tolerance";
+            break;
+        }
+        if(stopping.mse_relative_tolerance > 0 && previous_mse >= 0 && fabs(previous_mse - mse) <= stopping.mse_relative_tolerance * previous_mse) {
+            stop_reason = "mse relative decrease below tolerance";
+            break;
+        }
+        if(stopping.time_budget > 0 && elapsed >= stopping.time_budget) {
+            stop_reason = "time budget exhausted";
+            break;
+        }
+        previous_mse = mse;
+
+        // perform update: a damped Newton step, the masses being compared
+        // in the units of the source
+        bool accepted = newton_step(source, scaled_target_masses, min_mass, pd, trial, ws, newton, masses);
 
+        if(!accepted) {
+            // the masses are piecewise constant in the weights at the pixel
+            // scale, so the residual cannot be decreased any further
+            stop_reason = "no step decreases the residual";
+            break;
+        }
     }
 
+    std::cout << "Weight optimisation stopped after " << gradient_iter << " iterations: " << stop_reason << std::endl;
+
+    if(artifact_level >= 1 && last_render != gradient_iter) {
+        render_interpolation(renderer, displacement, *pd, render.mode, gradient_iter, interoplation_steps, writer, sequence);
+    }
+
+    std::cout << "Mapping passes: " << lloyd_passes << " for the quantization, " << multiscale_passes << " for the coarse levels, " << ws.passes
+              << " for the weight optimisation, " << renderer.passes() + displacement.passes() << " for the rendering" << std::endl;
+
+    delete pd;
+    delete trial;
+    delete sequence;
+
     return;
 }
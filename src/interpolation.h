@@ -1,8 +1,88 @@
 #ifndef interpolation_h_INCLUDED
 #define interpolation_h_INCLUDED
 
-/* Computes the interpolation between source_image and target_image */
-void interpolation(std::string source_image, std::string target_image, int N);
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "power_diagram.h"
+#include "diagram_export.h"
+#include "image.h"
+#include "image_writer.h"
+#include "sequence_writer.h"
+#include "lloyd.h"
+#include "multiscale.h"
+
+/* When to stop the optimisation of the transport weights; a criterion set
+   to 0 is disabled */
+struct StoppingCriteria
+{
+    // hard cap on the number of iterations
+    int max_iter = 10000;
+    // stop when the mse gets below mse_tolerance, or decreases by less than
+    // mse_relative_tolerance times its previous value
+    double mse_tolerance = 0.;
+    double mse_relative_tolerance = 0.;
+    // stop when every cell mass is within this fraction of the average cell
+    // mass from its target
+    double residual_tolerance = 1e-2;
+    // wall-clock budget of the optimisation, in seconds
+    double time_budget = 0.;
+};
+
+/* How the frames of the interpolation are drawn */
+enum RenderMode
+{
+    // the cells of the diagram with scaled weights, painted with the mean
+    // gray of the source under them (FrameRenderer)
+    RENDER_CELLS,
+    // the mass of each cell moved along the transport (DisplacementRenderer)
+    RENDER_DISPLACEMENT
+};
+
+/* Which frames of the interpolation are rendered: every interpolation_rate
+   iterations of the weight optimisation and once it stops, the frames at
+   times 1/interpolation_steps ... (interpolation_steps-1)/interpolation_steps.
+   The frames go to PNG files, or are all appended to a single sequence
+   written to sequence_output at fps frames per second */
+struct RenderSettings
+{
+    int interpolation_rate = 300;
+    int interpolation_steps = 10;
+    RenderMode mode = RENDER_CELLS;
+    SequenceFormat sequence = SEQUENCE_PNG;
+    std::string sequence_output;
+    int fps = 25;
+};
+
+/* How the initial sites are drawn from the density 1-gray of the target */
+enum SamplingMode
+{
+    // independent draws, the pixels drawn twice being rejected
+    SAMPLING_RANDOM,
+    // one draw per stratum of equal mass along a Hilbert curve
+    SAMPLING_STRATIFIED
+};
+
+/* How the target is quantized by the sites; a seed of 0 draws a random one */
+struct QuantizationSettings
+{
+    SamplingMode sampling = SAMPLING_RANDOM;
+    unsigned int seed = 0;
+    LloydSettings lloyd;
+};
+
+/* Quantizes the density 1-gray of image with N sites, placed by Lloyd
+   iterations from a sample drawn as asked by quantization, and gives the gray mass of their cells;
+   returns the number of Lloyd passes it made */
+int lloyd_sampling(const Image &image, std::vector< std::pair<double, double> > &sample, std::vector< double > &masses, int N, const QuantizationSettings &quantization, PowerBackend backend, ImageWriter &writer);
+
+/* Computes the interpolation between source_image and target_image, the
+   power diagrams being built with the given backend; the weights start
+   from the coarse levels asked by multiscale, the frames are
+   rendered as asked by render and the diagrams of the
+   weight optimisation are written as asked by exporter */
+void interpolation(std::string source_image, std::string target_image, int N, const StoppingCriteria &stopping, const QuantizationSettings &quantization, const MultiscaleSettings &multiscale, const RenderSettings &render, PowerBackend backend, const DiagramExport &exporter);
 
 #endif // interpolation_h_INCLUDED
 
@@ -0,0 +1,272 @@
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <string>
+#include <omp.h>
+
+#include "lloyd.h"
+
+LloydQuantizer::LloydQuantizer(const Image &source, PowerBackend b)
+{
+    image = &source;
+    backend = b;
+    pd = NULL;
+    width = source.width;
+    height = source.height;
+    nb_sites = 0;
+    passes = 0;
+    energy = 0.;
+
+    int nb_threads = omp_get_max_threads();
+    thread_runs.resize(nb_threads);
+    thread_labels.assign(nb_threads, std::vector< int >(width));
+}
+
+LloydQuantizer::~LloydQuantizer()
+{
+    delete pd;
+}
+
+void LloydQuantizer::accumulate(const std::vector< std::pair<double, double> > &sites)
+{
+    passes++;
+    nb_sites = sites.size();
+
+    // a Voronoi diagram is a power diagram with equal weights
+    delete pd;
+    pd = new PowerDiagram(sites, std::vector< double >(nb_sites, 0.), width, height, backend);
+    rasterizer.setup(*pd, width, height);
+
+    // a team smaller than asked leaves bands unused, they must hold no runs
+    for(std::vector< LloydRun > &runs : thread_runs) {
+        runs.clear();
+    }
+
+    #pragma omp parallel num_threads(thread_runs.size())
+    {
+        int nb_threads = omp_get_num_threads();
+        int thread = omp_get_thread_num();
+        int band_begin = (long)height * thread / nb_threads;
+        int band_end = (long)height * (thread+1) / nb_threads;
+
+        std::vector< LloydRun > &runs = thread_runs[thread];
+        int *labels = &thread_labels[thread][0];
+
+        for(int y = band_begin; y < band_end; y++) {
+            rasterizer.rasterize_row(y, labels);
+            const double *gs = image->row(y);
+
+            for(int x = 0; x < width; ) {
+                LloydRun run;
+                run.site = labels[x];
+                run.density = 0.;
+                run.moment_x = 0.;
+                run.weight = 0.;
+                run.energy = 0.;
+                double site_x = sites[run.site].first;
+                for(; x < width && labels[x] == run.site; x++) {
+                    double density = 1-gs[x];
+                    run.density += density;
+                    run.moment_x += x * density;
+                    run.weight += gs[x];
+                    run.energy += (x - site_x) * (x - site_x) * density;
+                }
+                double dy = y - sites[run.site].second;
+                run.moment_y = y * run.density;
+                run.energy += dy * dy * run.density;
+                runs.push_back(run);
+            }
+        }
+    }
+
+    site_density.assign(nb_sites, 0.);
+    site_moment_x.assign(nb_sites, 0.);
+    site_moment_y.assign(nb_sites, 0.);
+    site_weight.assign(nb_sites, 0.);
+    energy = 0.;
+
+    // the bands follow each other, so the runs are reduced in row order
+    for(const std::vector< LloydRun > &runs : thread_runs) {
+        for(const LloydRun &run : runs) {
+            site_density[run.site] += run.density;
+            site_moment_x[run.site] += run.moment_x;
+            site_moment_y[run.site] += run.moment_y;
+            site_weight[run.site] += run.weight;
+            energy += run.energy;
+        }
+    }
+}
+
+double LloydQuantizer::centroids(const std::vector< std::pair<double, double> > &sites, std::vector< std::pair<double, double> > &centroid) const
+{
+    double displacement = 0.;
+    centroid.resize(nb_sites);
+    for(int i = 0; i < nb_sites; i++) {
+        // a cell lying on white pixels only has no centroid, keep its site
+        if(site_density[i] <= 0) {
+            centroid[i] = sites[i];
+            continue;
+        }
+        centroid[i] = std::make_pair(site_moment_x[i]/site_density[i], site_moment_y[i]/site_density[i]);
+        displacement = std::max(displacement, hypot(centroid[i].first - sites[i].first, centroid[i].second - sites[i].second));
+    }
+    return displacement;
+}
+
+// solves the m x m system a x = b in place by Gaussian elimination with
+// partial pivoting, a being stored row by row
+static void solve_dense(std::vector< double > &a, std::vector< double > &b, int m)
+{
+    for(int k = 0; k < m; k++) {
+        int pivot = k;
+        for(int r = k+1; r < m; r++) {
+            if(fabs(a[r*m + k]) > fabs(a[pivot*m + k])) pivot = r;
+        }
+        if(pivot != k) {
+            for(int c = 0; c < m; c++) std::swap(a[k*m + c], a[pivot*m + c]);
+            std::swap(b[k], b[pivot]);
+        }
+        if(a[k*m + k] == 0.) continue;
+        for(int r = k+1; r < m; r++) {
+            double f = a[r*m + k] / a[k*m + k];
+            for(int c = k; c < m; c++) a[r*m + c] -= f * a[k*m + c];
+            b[r] -= f * b[k];
+        }
+    }
+    for(int k = m-1; k >= 0; k--) {
+        double v = b[k];
+        for(int c = k+1; c < m; c++) v -= a[k*m + c] * b[c];
+        b[k] = (a[k*m + k] == 0.) ? 0. : v / a[k*m + k];
+    }
+}
+
+int LloydQuantizer::run(std::vector< std::pair<double, double> > &sites, const LloydSettings &settings,
+                        const std::function<void(int, const std::vector< std::pair<double, double> >&)> &monitor)
+{
+    int n = sites.size();
+    std::vector< std::pair<double, double> > centroid, proposal(n);
+
+    // Anderson history, as vectors of the 2n coordinates: the differences
+    // between successive residuals (centroid minus site) and sites
+    std::deque< std::vector< double > > residual_steps, site_steps;
+    std::vector< double > residual(2*n), previous_residual(2*n), previous_site(2*n);
+    bool has_previous = false;
+
+    accumulate(sites);
+    if(monitor) monitor(0, sites);
+
+    int iter = 0;
+    while(iter < settings.iterations) {
+        double displacement = centroids(sites, centroid);
+        if(displacement <= settings.tolerance) break;
+        iter++;
+
+        if(settings.method == LLOYD_PLAIN) {
+            proposal = centroid;
+        } else if(settings.method == LLOYD_OVERRELAXED) {
+            for(int i = 0; i < n; i++) {
+                proposal[i].first = sites[i].first + settings.relaxation * (centroid[i].first - sites[i].first);
+                proposal[i].second = sites[i].second + settings.relaxation * (centroid[i].second - sites[i].second);
+            }
+        } else {
+            for(int i = 0; i < n; i++) {
+                residual[2*i] = centroid[i].first - sites[i].first;
+                residual[2*i+1] = centroid[i].second - sites[i].second;
+            }
+            if(has_previous) {
+                std::vector< double > dr(2*n), ds(2*n);
+                for(int i = 0; i < n; i++) {
+                    ds[2*i] = sites[i].first - previous_site[2*i];
+                    ds[2*i+1] = sites[i].second - previous_site[2*i+1];
+                }
+                for(int k = 0; k < 2*n; k++) {
+                    dr[k] = residual[k] - previous_residual[k];
+                }
+                residual_steps.push_back(dr);
+                site_steps.push_back(ds);
+                if((int)residual_steps.size() > settings.anderson_depth) {
+                    residual_steps.pop_front();
+                    site_steps.pop_front();
+                }
+            }
+            for(int i = 0; i < n; i++) {
+                previous_site[2*i] = sites[i].first;
+                previous_site[2*i+1] = sites[i].second;
+            }
+            previous_residual = residual;
+            has_previous = true;
+
+            // least squares combination of the residual steps closest to
+            // the residual, through slightly regularised normal equations
+            int m = residual_steps.size();
+            std::vector< double > normal(m*m), gamma(m);
+            double trace = 0.;
+            for(int a = 0; a < m; a++) {
+                for(int b = 0; b <= a; b++) {
+                    double dot = 0.;
+                    for(int k = 0; k < 2*n; k++) dot += residual_steps[a][k] * residual_steps[b][k];
+                    normal[a*m + b] = normal[b*m + a] = dot;
+                }
+                double dot = 0.;
+                for(int k = 0; k < 2*n; k++) dot += residual_steps[a][k] * residual[k];
+                gamma[a] = dot;
+                trace += normal[a*m + a];
+            }
+            for(int a = 0; a < m; a++) normal[a*m + a] += 1e-10 * trace;
+            solve_dense(normal, gamma, m);
+
+            // the mixed sites take a relaxed step along the mixed residual
+            double beta = settings.relaxation;
+            for(int k = 0; k < 2*n; k++) {
+                double site = previous_site[k], step = residual[k];
+                for(int a = 0; a < m; a++) {
+                    site -= gamma[a] * site_steps[a][k];
+                    step -= gamma[a] * residual_steps[a][k];
+                }
+                double next = site + beta * step;
+                if(k % 2) proposal[k/2].second = next; else proposal[k/2].first = next;
+            }
+        }
+
+        // extrapolated sites must stay within the pixel centers, a site
+        // beyond the last ones could get a cell holding no pixel
+        for(int i = 0; i < n; i++) {
+            proposal[i].first = std::min(std::max(proposal[i].first, 0.), width - 1.);
+            proposal[i].second = std::min(std::max(proposal[i].second, 0.), height - 1.);
+        }
+
+        double previous_energy = energy;
+        accumulate(proposal);
+        if(settings.method != LLOYD_PLAIN && energy > previous_energy) {
+            // the extrapolation overshot, take the plain step and forget
+            // the history leading to it
+            residual_steps.clear();
+            site_steps.clear();
+            has_previous = false;
+            proposal = centroid;
+            accumulate(proposal);
+        }
+        sites.swap(proposal);
+        if(monitor) monitor(iter, sites);
+
+        if(previous_energy - energy <= settings.energy_tolerance * previous_energy) break;
+    }
+
+    return iter;
+}
+
+bool parse_lloyd_method(const std::string &name, LloydMethod &method)
+{
+    if(name == "plain") {
+        method = LLOYD_PLAIN;
+    } else if(name == "overrelaxed") {
+        method = LLOYD_OVERRELAXED;
+    } else if(name == "anderson") {
+        method = LLOYD_ANDERSON;
+    } else {
+        return false;
+    }
+    return true;
+}
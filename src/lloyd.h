@@ -0,0 +1,113 @@
+#ifndef lloyd_h_INCLUDED
+#define lloyd_h_INCLUDED
+
+#include <vector>
+#include <utility>
+#include <string>
+#include <functional>
+
+#include "image.h"
+#include "power_diagram.h"
+#include "rasterizer.h"
+
+/* Sums of a run of consecutive pixels of a row owned by the same site */
+struct LloydRun
+{
+    int site;
+    double density;
+    double moment_x;
+    double moment_y;
+    double weight;
+    double energy;
+};
+
+/* How the sites move from one Lloyd iteration to the next */
+enum LloydMethod
+{
+    // to the centroids of their cells
+    LLOYD_PLAIN,
+    // past the centroids, by relaxation times the plain step; a relaxation
+    // between 1 and 2 usually needs fewer iterations than the plain step
+    LLOYD_OVERRELAXED,
+    // by a relaxed step from the combination of the last anderson_depth
+    // sites whose residuals (centroid minus site) cancel best (Anderson
+    // mixing)
+    LLOYD_ANDERSON
+};
+
+/* Stopping tests and acceleration of the Lloyd iterations: they stop after
+   iterations, once no centroid lies further than tolerance pixels from its
+   site, or once an iteration lowers the energy by at most energy_tolerance
+   times its value. An accelerated step raising the energy is replaced by
+   the plain step */
+struct LloydSettings
+{
+    LloydMethod method = LLOYD_PLAIN;
+    int iterations = 10;
+    double tolerance = 0.;
+    double energy_tolerance = 0.;
+    double relaxation = 1.8;
+    int anderson_depth = 2;
+};
+
+/* Lloyd relaxation of sites towards the centroids of their Voronoi cells,
+   for the density 1-gray of an image. Each pass labels the rows of the image
+   in parallel, every thread summing the runs of its band of rows; the runs
+   are then reduced in row order, so that the centroids do not depend on the
+   number of threads */
+class LloydQuantizer
+{
+    public:
+        int width;
+        int height;
+        int nb_sites;
+
+        // sums over the cell of each site of the density 1-gray, of its
+        // products with x and y, and of the gray levels
+        std::vector< double > site_density;
+        std::vector< double > site_moment_x;
+        std::vector< double > site_moment_y;
+        std::vector< double > site_weight;
+        // quantization energy, the sum over the pixels of the density times
+        // the squared distance to the site of their cell
+        double energy;
+
+        // number of accumulate calls made
+        int passes;
+
+        LloydQuantizer(const Image &image, PowerBackend backend = POWER_NATIVE);
+        ~LloydQuantizer();
+
+        /* Computes the Voronoi cells of sites, and the sums of their pixels */
+        void accumulate(const std::vector< std::pair<double, double> > &sites);
+
+        /* Centroids of the cells last accumulated, a cell holding no density
+           giving its site; returns the largest distance from a site to its
+           centroid */
+        double centroids(const std::vector< std::pair<double, double> > &sites, std::vector< std::pair<double, double> > &centroid) const;
+
+        /* Runs Lloyd iterations from sites as asked by settings, the cells
+           of the final sites being left accumulated; monitor, if set, is
+           called with the iteration and the sites after each accumulation of
+           accepted sites. Returns the number of iterations made */
+        int run(std::vector< std::pair<double, double> > &sites, const LloydSettings &settings,
+                const std::function<void(int, const std::vector< std::pair<double, double> >&)> &monitor = nullptr);
+
+        /* Diagram of the sites last accumulated */
+        const PowerDiagram &diagram() const { return *pd; }
+
+    private:
+        const Image *image;
+        PowerBackend backend;
+        PowerDiagram *pd;
+        Rasterizer rasterizer;
+
+        // runs of each thread's band, in row order, and its row labels
+        std::vector< std::vector< LloydRun > > thread_runs;
+        std::vector< std::vector< int > > thread_labels;
+};
+
+/* Parses "plain", "overrelaxed" or "anderson", returns false for other names */
+bool parse_lloyd_method(const std::string &name, LloydMethod &method);
+
+#endif // lloyd_h_INCLUDED
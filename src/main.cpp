@@ -1,8 +1,11 @@
 #include <vector>
 #include <iostream>
+#include <algorithm>
 
 #include "optionparser.h"
 #include "interpolation.h"
+#include "benchmark.h"
+#include "debug.h"
 
 struct Arg: public option::Arg
 {
@@ -58,18 +61,61 @@ struct Arg: public option::Arg
         }
         return option::ARG_ILLEGAL;
     }
+    static option::ArgStatus Real(const option::Option& option, bool msg)
+    {
+        char* endptr = 0;
+        if (option.arg != 0 && strtod(option.arg, &endptr)) {};
+
+        if (endptr != option.arg && *endptr == 0) {
+            return option::ARG_OK;
+        }
+
+        if (msg) {
+            printError("Option '", option, "' requires a real argument\n");
+        }
+        return option::ARG_ILLEGAL;
+    }
 };
 
-enum  optionIndex { UNKNOWN, HELP, N};
+enum  optionIndex { UNKNOWN, HELP, RESDIRAC, MAX_ITER, SAMPLING, SEED, LLOYD_METHOD, LLOYD_ITER, LLOYD_TOL, LLOYD_ENERGY_TOL, LLOYD_RELAXATION, LLOYD_DEPTH, MULTISCALE, MULTISCALE_ITER, FRAMES, RENDER_RATE, RENDERER, SEQUENCE, SEQUENCE_OUTPUT, FPS, MSE_TOL, MSE_REL_TOL, RESIDUAL_TOL, TIME_BUDGET, BACKEND, EXPORT_DIAGRAM, EXPORT_INTERVAL, EXPORT_PREFIX, VERBOSITY, ARTIFACTS, BENCHMARK};
 
 const option::Descriptor usage[] = {
     { UNKNOWN, 0,"", "",        Arg::Unknown, "USAGE: temp_name source.png target.png [options]\n\n"
                                               "Options:" },
     { HELP,    0,"h", "help",    Arg::None,    "  \t--help  \tPrint usage and exit." },
-    { N, 0,"N","resdirac", Arg::Numeric, "  -N <num>, \t--resdirac=<num>  \tSpecify the number of Diracs used to sample target image" },
+    { RESDIRAC, 0,"N","resdirac", Arg::Numeric, "  -N <num>, \t--resdirac=<num>  \tSpecify the number of Diracs used to sample target image" },
+    { MAX_ITER, 0,"i","max-iter", Arg::Numeric, "  -i <num>, \t--max-iter=<num>  \tMaximal number of iterations of the weight optimisation (default 10000)" },
+    { SAMPLING, 0,"","sampling", Arg::NonEmpty, "  \t--sampling=<mode>  \tDraw the initial sites independently (random, default) or one per stratum of equal mass (stratified)" },
+    { SEED, 0,"","seed", Arg::Numeric, "  \t--seed=<num>  \tSeed of the initial sampling, 0 for a random one (default)" },
+    { LLOYD_METHOD, 0,"","lloyd-method", Arg::NonEmpty, "  \t--lloyd-method=<name>  \tMove the sites to their centroids (plain, default), past them (overrelaxed) or by Anderson mixing of the last iterations (anderson)" },
+    { LLOYD_ITER, 0,"","lloyd-iter", Arg::Numeric, "  \t--lloyd-iter=<num>  \tMaximal number of Lloyd iterations quantizing the target (default 10)" },
+    { LLOYD_TOL, 0,"","lloyd-tol", Arg::Real, "  \t--lloyd-tol=<real>  \tStop the Lloyd iterations once no site moves by more than this many pixels (default 0)" },
+    { LLOYD_ENERGY_TOL, 0,"","lloyd-energy-tol", Arg::Real, "  \t--lloyd-energy-tol=<real>  \tStop the Lloyd iterations once an iteration lowers the quantization energy by at most this fraction (default 0)" },
+    { LLOYD_RELAXATION, 0,"","lloyd-relaxation", Arg::Real, "  \t--lloyd-relaxation=<real>  \tStep of the overrelaxed and Anderson Lloyd iterations, relative to the plain step (default 1.8)" },
+    { LLOYD_DEPTH, 0,"","lloyd-depth", Arg::Numeric, "  \t--lloyd-depth=<num>  \tNumber of past iterations mixed by the Anderson Lloyd iterations (default 2)" },
+    { MULTISCALE, 0,"","multiscale", Arg::Numeric, "  \t--multiscale=<num>  \tStart the weight optimisation from <num> coarser levels, each halving the images and quartering the sites (default 0)" },
+    { MULTISCALE_ITER, 0,"","multiscale-iter", Arg::Numeric, "  \t--multiscale-iter=<num>  \tMaximal number of iterations of the weight optimisation at each coarse level (default 50)" },
+    { FRAMES, 0,"f","frames", Arg::Numeric, "  -f <num>, \t--frames=<num>  \tRender the interpolation at times 1/<num> ... (<num>-1)/<num> (default 10)" },
+    { RENDER_RATE, 0,"","render-rate", Arg::Numeric, "  \t--render-rate=<num>  \tRender the interpolation every <num> iterations of the weight optimisation, and when it stops (default 300)" },
+    { RENDERER, 0,"","renderer", Arg::NonEmpty, "  \t--renderer=<name>  \tDraw the frames as power cells with scaled weights (cells, default) or by moving the mass of each cell along the transport (displacement)" },
+    { SEQUENCE, 0,"","sequence", Arg::NonEmpty, "  \t--sequence=<format>  \tWrite every rendered frame to one png file each (default), or append them to a single gif, apng or y4m sequence" },
+    { SEQUENCE_OUTPUT, 0,"o","output", Arg::NonEmpty, "  -o <path>, \t--output=<path>  \tFile of the sequence, - for the standard output (default debug_imgs/interpolation.<format>, or - for y4m)" },
+    { FPS, 0,"","fps", Arg::Numeric, "  \t--fps=<num>  \tFrame rate of the sequence (default 25)" },
+    { MSE_TOL, 0,"","mse-tol", Arg::Real, "  \t--mse-tol=<real>  \tStop once the mse is below this value (0 disables)" },
+    { MSE_REL_TOL, 0,"","mse-rel-tol", Arg::Real, "  \t--mse-rel-tol=<real>  \tStop once the mse decreases by less than this fraction between two iterations (0 disables)" },
+    { RESIDUAL_TOL, 0,"","residual-tol", Arg::Real, "  \t--residual-tol=<real>  \tStop once every cell mass is within this fraction of the average cell mass from its target (default 0.01)" },
+    { TIME_BUDGET, 0,"","time-budget", Arg::Real, "  \t--time-budget=<sec>  \tStop the weight optimisation after this many seconds (0 disables)" },
+    { BACKEND, 0,"","backend", Arg::NonEmpty, "  \t--backend=<name>  \tHow power diagrams are computed: native (default), lifted or radical" },
+    { EXPORT_DIAGRAM, 0,"","export-diagram", Arg::NonEmpty, "  \t--export-diagram=<format>  \tWrite the power diagrams of the weight optimisation as gnuplot, binary or svg files (default none)" },
+    { EXPORT_INTERVAL, 0,"","export-interval", Arg::Numeric, "  \t--export-interval=<num>  \tOnly export the diagram every <num> iterations (default 1)" },
+    { EXPORT_PREFIX, 0,"","export-prefix", Arg::NonEmpty, "  \t--export-prefix=<path>  \tPrefix of the exported diagram files (default debug_imgs/diagram)" },
+    { VERBOSITY, 0,"v","verbosity", Arg::Numeric, "  -v <num>, \t--verbosity=<num>  \t0 prints only the final summary, 1 the progress (default), 2 also debugging traces" },
+    { ARTIFACTS, 0,"","artifacts", Arg::Numeric, "  \t--artifacts=<num>  \t0 writes no image, 1 the interpolation frames (default), 2 also the Lloyd debugging images" },
+    { BENCHMARK, 0,"b","benchmark", Arg::NonEmpty, "  -b <name>, \t--benchmark=<name>  \tRun a benchmark instead of an interpolation; 'diagram' compares the power diagram backends, 'debug' the cost of the debugging artifacts, 'frames' the rendering of long sequences, 'lloyd' the Lloyd methods, 'alloc' the allocations of the solver steps (fails if they allocate)" },
     { UNKNOWN, 0,"", "",        Arg::None,
      "\nExamples:\n"
      "  texture_generation source.png target.png\n"
+     "  texture_generation --benchmark=diagram\n"
     },
     { 0, 0, 0, 0, 0, 0 } 
 };
@@ -79,22 +125,30 @@ int main(int argc, char* argv[])
     argc-=(argc>0); argv+=(argc>0); // skip program name argv[0] if present
 
     std::string source_image_name, target_image_name;
-    int N = 128;
+    int N = 700;
+    StoppingCriteria stopping;
+    QuantizationSettings quantization;
+    MultiscaleSettings multiscale;
+    RenderSettings render;
+    PowerBackend backend = POWER_NATIVE;
+    DiagramExport exporter;
     
-    bool source_image_path_argument = (argc > 0);
+    bool source_image_path_argument = (argc > 0 && argv[0][0] != '-');
 
     if(source_image_path_argument) {
         source_image_name = std::string(argv[0]);
     }
     
-    argc -= (argc>0); argv += (argc>0); // skip image name if present
+    argc -= source_image_path_argument; argv += source_image_path_argument; // skip image name if present
 
-    bool target_image_path_argument = (argc > 0);
+    bool target_image_path_argument = (source_image_path_argument && argc > 0 && argv[0][0] != '-');
 
     if(target_image_path_argument) {
         target_image_name = std::string(argv[0]);
     }
 
+    argc -= target_image_path_argument; argv += target_image_path_argument; // skip image name if present
+
     option::Stats stats(usage, argc, argv);
 
     std::vector<option::Option> options(stats.options_max);
@@ -105,6 +159,43 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    // the levels also apply to the benchmarks
+    for (int i = 0; i < parse.optionsCount(); ++i)
+    {
+        option::Option& opt = buffer[i];
+        if(opt.index() == VERBOSITY) {
+            verbosity = std::stoi(opt.arg);
+        } else if(opt.index() == ARTIFACTS) {
+            artifact_level = std::stoi(opt.arg);
+        }
+    }
+
+    if (options[BENCHMARK] && !options[HELP])
+    {
+        std::string benchmark = options[BENCHMARK].last()->arg;
+        if(benchmark == "diagram") {
+            benchmark_power_diagrams();
+            return 0;
+        }
+        if(benchmark == "frames") {
+            benchmark_frame_sequence();
+            return 0;
+        }
+        if(benchmark == "lloyd") {
+            benchmark_lloyd_methods();
+            return 0;
+        }
+        if(benchmark == "debug") {
+            benchmark_debug_levels();
+            return 0;
+        }
+        if(benchmark == "alloc") {
+            return benchmark_solver_allocations() ? 0 : 1;
+        }
+        std::cerr << "Unknown benchmark '" << benchmark << "'" << std::endl;
+        return 1;
+    }
+
     if (options[HELP] || !(source_image_path_argument && target_image_path_argument))
     {
         int columns = getenv("COLUMNS")? atoi(getenv("COLUMNS")) : 80;
@@ -115,15 +206,118 @@ int main(int argc, char* argv[])
     for (int i = 0; i < parse.optionsCount(); ++i)
     {
         option::Option& opt = buffer[i];
-        if(opt.index() == N) {
+        if(opt.index() == RESDIRAC) {
             N = std::stoi(opt.arg);
+        } else if(opt.index() == MAX_ITER) {
+            stopping.max_iter = std::stoi(opt.arg);
+        } else if(opt.index() == SAMPLING) {
+            std::string sampling = opt.arg;
+            if(sampling == "random") {
+                quantization.sampling = SAMPLING_RANDOM;
+            } else if(sampling == "stratified") {
+                quantization.sampling = SAMPLING_STRATIFIED;
+            } else {
+                std::cerr << "Unknown sampling mode '" << sampling << "'" << std::endl;
+                return 1;
+            }
+        } else if(opt.index() == SEED) {
+            quantization.seed = std::stoul(opt.arg);
+        } else if(opt.index() == LLOYD_METHOD) {
+            if(!parse_lloyd_method(opt.arg, quantization.lloyd.method)) {
+                std::cerr << "Unknown Lloyd method '" << opt.arg << "'" << std::endl;
+                return 1;
+            }
+        } else if(opt.index() == LLOYD_ITER) {
+            quantization.lloyd.iterations = std::max(std::stoi(opt.arg), 1);
+        } else if(opt.index() == LLOYD_TOL) {
+            quantization.lloyd.tolerance = std::stod(opt.arg);
+        } else if(opt.index() == LLOYD_ENERGY_TOL) {
+            quantization.lloyd.energy_tolerance = std::stod(opt.arg);
+        } else if(opt.index() == LLOYD_RELAXATION) {
+            quantization.lloyd.relaxation = std::stod(opt.arg);
+        } else if(opt.index() == LLOYD_DEPTH) {
+            quantization.lloyd.anderson_depth = std::max(std::stoi(opt.arg), 1);
+        } else if(opt.index() == MULTISCALE) {
+            multiscale.levels = std::max(std::stoi(opt.arg), 0);
+        } else if(opt.index() == MULTISCALE_ITER) {
+            multiscale.max_iter = std::max(std::stoi(opt.arg), 1);
+        } else if(opt.index() == FRAMES) {
+            render.interpolation_steps = std::stoi(opt.arg);
+        } else if(opt.index() == RENDER_RATE) {
+            render.interpolation_rate = std::max(std::stoi(opt.arg), 1);
+        } else if(opt.index() == RENDERER) {
+            std::string renderer = opt.arg;
+            if(renderer == "cells") {
+                render.mode = RENDER_CELLS;
+            } else if(renderer == "displacement") {
+                render.mode = RENDER_DISPLACEMENT;
+            } else {
+                std::cerr << "Unknown renderer '" << renderer << "'" << std::endl;
+                return 1;
+            }
+        } else if(opt.index() == SEQUENCE) {
+            if(!parse_sequence_format(opt.arg, render.sequence)) {
+                std::cerr << "Unknown sequence format '" << opt.arg << "'" << std::endl;
+                return 1;
+            }
+        } else if(opt.index() == SEQUENCE_OUTPUT) {
+            render.sequence_output = opt.arg;
+        } else if(opt.index() == FPS) {
+            render.fps = std::stoi(opt.arg);
+        } else if(opt.index() == MSE_TOL) {
+            stopping.mse_tolerance = std::stod(opt.arg);
+        } else if(opt.index() == MSE_REL_TOL) {
+            stopping.mse_relative_tolerance = std::stod(opt.arg);
+        } else if(opt.index() == RESIDUAL_TOL) {
+            stopping.residual_tolerance = std::stod(opt.arg);
+        } else if(opt.index() == TIME_BUDGET) {
+            stopping.time_budget = std::stod(opt.arg);
+        } else if(opt.index() == BACKEND) {
+            if(!parse_power_backend(opt.arg, backend)) {
+                std::cerr << "Unknown power diagram backend '" << opt.arg << "'" << std::endl;
+                return 1;
+            }
+        } else if(opt.index() == EXPORT_DIAGRAM) {
+            if(!parse_diagram_format(opt.arg, exporter.format)) {
+                std::cerr << "Unknown diagram format '" << opt.arg << "'" << std::endl;
+                return 1;
+            }
+        } else if(opt.index() == EXPORT_INTERVAL) {
+            exporter.interval = std::stoi(opt.arg);
+        } else if(opt.index() == EXPORT_PREFIX) {
+            exporter.prefix = opt.arg;
         }
     }
 
-    std::cout << "Welcome in the project; trying to load " << source_image_name 
-              << " and " << target_image_name << std::endl;
+    if(N < 1) {
+        std::cerr << "The number of Diracs must be at least 1" << std::endl;
+        return 1;
+    }
+    if(render.interpolation_steps < 2) {
+        std::cerr << "At least 2 frames are needed to render an intermediate time" << std::endl;
+        return 1;
+    }
+
+    if(render.sequence == SEQUENCE_PNG && !render.sequence_output.empty()) {
+        std::cerr << "The png frames are written to one file each, --output needs a gif, apng or y4m sequence" << std::endl;
+        return 1;
+    }
+
+    if(render.sequence_output.empty()) {
+        const char *names[] = {"", "debug_imgs/interpolation.gif", "debug_imgs/interpolation.png", "-"};
+        render.sequence_output = names[render.sequence];
+    }
+    // the messages must not get mixed with a sequence streamed to stdout
+    if(render.sequence != SEQUENCE_PNG && render.sequence_output == "-") {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    if(verbosity >= 1) {
+        std::cout << "Welcome in the project; trying to load " << source_image_name 
+                  << " and " << target_image_name << std::endl;
+    }
 
-    interpolation(source_image_name, target_image_name, N);
+    interpolation(source_image_name, target_image_name, N, stopping, quantization, multiscale, render, backend, exporter);
 
     return 0;
 }
@@ -0,0 +1,253 @@
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include <omp.h>
+
+#include "image.h"
+#include "power_diagram.h"
+#include "rasterizer.h"
+#include "debug.h"
+
+#include "mapping.h"
+
+MappingWorkspace::MappingWorkspace()
+{
+    width = 0;
+    height = 0;
+    nb_sites = 0;
+    nb_threads = 0;
+    passes = 0;
+    labelled = false;
+}
+
+MappingWorkspace::MappingWorkspace(int w, int h, int n)
+{
+    width = 0;
+    height = 0;
+    nb_sites = 0;
+    passes = 0;
+    labelled = false;
+    resize(w, h, n);
+}
+
+void MappingWorkspace::resize(int w, int h, int n)
+{
+    if(w != width || h != height || n != nb_sites) {
+        labelled = false;
+        previous_begin.assign(n, -1);
+        previous_end.assign(n, -1);
+        touched.assign(n, 0);
+    }
+
+    width = w;
+    height = h;
+    nb_sites = n;
+
+    // a mapping made from within a parallel region (one frame per thread)
+    // runs on a team of one thread, the accumulators are sized accordingly
+    nb_threads = omp_in_parallel() ? 1 : omp_get_max_threads();
+
+    // image sized buffers are only allocated once an output needs them
+    row_labels.resize(nb_threads*w);
+    site_weight.resize(n);
+    site_count.resize(n);
+    thread_weight.resize(nb_threads*n);
+    thread_count.resize(nb_threads*n);
+}
+
+// re-examines the pixels around the spans that changed between the previous
+// and the current rasterization of ws, returns false (leaving ws untouched)
+// when so many pixels are involved that a full pass is cheaper
+static bool update_mapping(const Image &image, MappingWorkspace &ws)
+{
+    const Rasterizer &now = ws.rasterizer;
+    const Rasterizer &before = ws.previous_rasterizer;
+    int width = ws.width;
+    int height = ws.height;
+
+    ws.retest.clear();
+    long long retest_size = 0;
+    bool too_many = false;
+
+    auto add_retest = [&](int y, int x_begin, int x_end) {
+        ws.retest.push_back(y);
+        ws.retest.push_back(x_begin);
+        ws.retest.push_back(x_end);
+        retest_size += x_end - x_begin + 1;
+    };
+
+    for(int y = 0; y < height && !too_many; y++) {
+        for(int k = before.row_offset[y]; k < before.row_offset[y+1]; k++) {
+            ws.previous_begin[before.spans[k].site] = before.spans[k].begin;
+            ws.previous_end[before.spans[k].site] = before.spans[k].end;
+        }
+
+        // a pixel changing owner leaves the span of its old site or enters
+        // the span of its new one, unless it lies on an ambiguous endpoint
+        for(int k = now.row_offset[y]; k < now.row_offset[y+1]; k++) {
+            const RowSpan &span = now.spans[k];
+            int a = ws.previous_begin[span.site];
+            int b = ws.previous_end[span.site];
+            if(a < 0) {
+                add_retest(y, span.begin, span.end);
+                continue;
+            }
+            if(a != span.begin || span.ambiguous_begin) add_retest(y, std::min(a, span.begin), std::max(a, span.begin));
+            if(b != span.end || span.ambiguous_end) add_retest(y, std::min(b, span.end), std::max(b, span.end));
+            ws.previous_begin[span.site] = -2;
+        }
+
+        // sites which do not cross the row anymore
+        for(int k = before.row_offset[y]; k < before.row_offset[y+1]; k++) {
+            const RowSpan &span = before.spans[k];
+            if(ws.previous_begin[span.site] >= 0) add_retest(y, span.begin, span.end);
+            ws.previous_begin[span.site] = -1;
+        }
+
+        too_many = (retest_size > (long long)width*height/4);
+    }
+
+    // the pixels no span covers are labelled against every site, so they
+    // may change owner even though no span moved
+    for(const Rasterizer *r : {&before, &now}) {
+        for(int g = 0; g < (int)r->gaps.size() && !too_many; g += 3) {
+            add_retest(r->gaps[g], r->gaps[g+1], r->gaps[g+2]);
+            too_many = (retest_size > (long long)width*height/4);
+        }
+    }
+
+    if(too_many) return false;
+
+    ws.touched_sites.clear();
+    auto touch = [&](int i) {
+        if(!ws.touched[i]) {
+            ws.touched[i] = 1;
+            ws.touched_sites.push_back(i);
+        }
+    };
+
+    for(int r = 0; r < (int)ws.retest.size(); r += 3) {
+        int y = ws.retest[r];
+        int *labels = &ws.pix_to_site[y*width];
+        for(int x = ws.retest[r+1]; x <= ws.retest[r+2]; x++) {
+            int owner = now.locate(x, y);
+            if(owner == labels[x]) continue;
+
+            touch(labels[x]);
+            touch(owner);
+            labels[x] = owner;
+        }
+    }
+
+    if(ws.touched_sites.empty()) return true;
+
+    // the masses of the touched sites are summed again from their pixels
+    // rather than moved pixel by pixel, so that no rounding accumulates
+    // over the calls; their pixels lie in their spans or in the gaps
+    for(int i : ws.touched_sites) {
+        ws.site_weight[i] = 0.;
+        ws.site_count[i] = 0;
+    }
+
+    for(int y = 0; y < height; y++) {
+        const double *gs = image.row(y);
+        const int *labels = &ws.pix_to_site[y*width];
+        for(int k = now.row_offset[y]; k < now.row_offset[y+1]; k++) {
+            const RowSpan &span = now.spans[k];
+            if(!ws.touched[span.site]) continue;
+            for(int x = span.begin; x <= span.end; x++) {
+                if(labels[x] != span.site) continue;
+                ws.site_weight[span.site] += gs[x];
+                ws.site_count[span.site]++;
+            }
+        }
+    }
+
+    for(int r = 0; r < (int)now.gaps.size(); r += 3) {
+        int y = now.gaps[r];
+        const double *gs = image.row(y);
+        const int *labels = &ws.pix_to_site[y*width];
+        for(int x = now.gaps[r+1]; x <= now.gaps[r+2]; x++) {
+            if(!ws.touched[labels[x]]) continue;
+            ws.site_weight[labels[x]] += gs[x];
+            ws.site_count[labels[x]]++;
+        }
+    }
+
+    for(int i : ws.touched_sites) {
+        ws.touched[i] = 0;
+    }
+
+    return true;
+}
+
+void generate_mapping(const Image &image, const PowerDiagram &pd, MappingWorkspace &ws, int outputs)
+{
+    if(verbosity >= 2) std::cout << "Generate a mapping..." << std::endl;
+    ws.passes++;
+
+    int width = image.width;
+    int height = image.height;
+    int N = pd.nb_sites;
+
+    bool masses = (outputs & MAPPING_MASSES);
+
+    ws.resize(width, height, N);
+
+    std::swap(ws.rasterizer, ws.previous_rasterizer);
+    ws.rasterizer.setup(pd, width, height);
+
+    if(outputs & MAPPING_INCREMENTAL) {
+        if(ws.labelled && update_mapping(image, ws)) return;
+        outputs |= MAPPING_LABELS | MAPPING_MASSES;
+        masses = true;
+    }
+    ws.labelled = (outputs & MAPPING_LABELS) && (outputs & MAPPING_MASSES);
+
+    if(outputs & MAPPING_LABELS) ws.pix_to_site.resize(width*height);
+
+    if(masses) {
+        std::fill(ws.thread_weight.begin(), ws.thread_weight.end(), 0.);
+        std::fill(ws.thread_count.begin(), ws.thread_count.end(), 0);
+    }
+
+    // each thread labels a contiguous tile of rows (static schedule) and
+    // consumes every row while it is still in cache
+    #pragma omp parallel num_threads(ws.nb_threads)
+    {
+        int t = omp_get_thread_num();
+        double *weight = &ws.thread_weight[t*N];
+        int *count = &ws.thread_count[t*N];
+
+        #pragma omp for schedule(static)
+        for(int y = 0; y < height; y++) {
+            int *labels = (outputs & MAPPING_LABELS) ? &ws.pix_to_site[y*width] : &ws.row_labels[t*width];
+            ws.rasterizer.rasterize_row(y, labels);
+
+            const double *gs = image.row(y);
+            if(masses) {
+                for(int x = 0; x < width; x++) {
+                    weight[labels[x]] += gs[x];
+                    count[labels[x]]++;
+                }
+            }
+        }
+
+        // the per-thread sums are reduced in thread order, so the result
+        // does not depend on the scheduling for a given number of threads
+        #pragma omp for schedule(static)
+        for(int i = 0; i < N; i++) {
+            if(masses) {
+                double w = 0.;
+                int c = 0;
+                for(int s = 0; s < ws.nb_threads; s++) {
+                    w += ws.thread_weight[s*N + i];
+                    c += ws.thread_count[s*N + i];
+                }
+                ws.site_weight[i] = w;
+                ws.site_count[i] = c;
+            }
+        }
+    }
+}
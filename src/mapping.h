@@ -0,0 +1,75 @@
+#ifndef mapping_h_INCLUDED
+#define mapping_h_INCLUDED
+
+#include <vector>
+
+#include "image.h"
+#include "power_diagram.h"
+#include "rasterizer.h"
+
+/* Outputs generate_mapping can produce, to be or-ed together */
+enum MappingOutput
+{
+    // pix_to_site
+    MAPPING_LABELS = 1,
+    // site_weight and site_count
+    MAPPING_MASSES = 2,
+    // pix_to_site and the masses are updated from the previous call, only
+    // re-examining the pixels whose cell may have changed; the previous
+    // call must have mapped the same image (implies MAPPING_LABELS and
+    // MAPPING_MASSES, and falls back to a full pass when needed)
+    MAPPING_INCREMENTAL = 4
+};
+
+/* Buffers describing which site of a power diagram owns each pixel of an
+   image. They are sized once for a given image size and number of sites,
+   and refilled in place by generate_mapping */
+class MappingWorkspace
+{
+    public:
+        int width;
+        int height;
+        int nb_sites;
+
+        // site owning the pixel (x, y), stored at y*width + x
+        std::vector< int > pix_to_site;
+        // sum of the gray levels of the pixels of each site, and their number
+        std::vector< double > site_weight;
+        std::vector< int > site_count;
+
+        Rasterizer rasterizer;
+        // rasterization of the previously mapped diagram, and whether
+        // pix_to_site and the masses still describe it
+        Rasterizer previous_rasterizer;
+        bool labelled;
+        // per-site scratch used to match the previous spans of a row, and
+        // the (y, x_begin, x_end) pixel runs to re-examine
+        std::vector< int > previous_begin;
+        std::vector< int > previous_end;
+        std::vector< int > retest;
+        // sites which gained or lost pixels during an incremental update
+        std::vector< char > touched;
+        std::vector< int > touched_sites;
+
+        // number of generate_mapping calls made with this workspace
+        int passes;
+
+        int nb_threads;
+        // per-thread labels of the current row, used when pix_to_site is not
+        // requested, and per-thread copies of the site accumulators (thread
+        // t owns the entries t*nb_sites ... (t+1)*nb_sites-1)
+        std::vector< int > row_labels;
+        std::vector< double > thread_weight;
+        std::vector< int > thread_count;
+
+        MappingWorkspace();
+        MappingWorkspace(int width, int height, int nb_sites);
+
+        void resize(int width, int height, int nb_sites);
+};
+
+/* Fills the requested outputs of ws (a combination of MappingOutput) with
+   the mapping between the pixels of image and the cells of pd */
+void generate_mapping(const Image &image, const PowerDiagram &pd, MappingWorkspace &ws, int outputs);
+
+#endif // mapping_h_INCLUDED
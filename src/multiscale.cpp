@@ -0,0 +1,257 @@
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+
+#include "image.h"
+#include "power_diagram.h"
+#include "mapping.h"
+#include "rasterizer.h"
+#include "transport.h"
+#include "lloyd.h"
+#include "multiscale.h"
+#include "debug.h"
+
+// levels with fewer sites or a smaller side than this are not built
+#define MULTISCALE_MIN_SITES 16
+#define MULTISCALE_MIN_SIDE 16
+// rounds of fill_empty_cells
+#define MULTISCALE_FILL_ROUNDS 8
+
+// a level of the pyramid: the halved images, the sites quantizing the target
+// and their target masses, and the coarse site owning each finer site
+struct Level
+{
+    Image source;
+    Image target;
+    std::vector< std::pair<double, double> > sites;
+    std::vector< double > masses;
+    std::vector< int > parent;
+};
+
+// averages the blocks of 2x2 pixels, the last row and column of odd sizes
+// averaging the pixels they have
+static void downsample(const Image &image, Image &half)
+{
+    int width = (image.width + 1) / 2;
+    int height = (image.height + 1) / 2;
+    half = Image(height, width, 1);
+
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            double sum = 0.;
+            int count = 0;
+            for(int fy = 2*y; fy < std::min(2*y + 2, image.height); fy++) {
+                for(int fx = 2*x; fx < std::min(2*x + 2, image.width); fx++) {
+                    sum += image.at(fx, fy);
+                    count++;
+                }
+            }
+            half.at(x, y) = sum / count;
+        }
+    }
+}
+
+// position in the halved image of the point p, pixel centers being at
+// integer coordinates at both levels
+static std::pair<double, double> coarsen(const std::pair<double, double> &p, const Image &half)
+{
+    double x = (p.first + 0.5) / 2 - 0.5;
+    double y = (p.second + 0.5) / 2 - 0.5;
+    return std::make_pair(std::min(std::max(x, 0.), half.width - 1e-6), std::min(std::max(y, 0.), half.height - 1e-6));
+}
+
+// builds the level coarser than fine, adding the mapping passes of its
+// quantization to passes; returns false when it would be too small
+static bool build_level(const Level &fine, const LloydSettings &lloyd, PowerBackend backend, Level &coarse, int &passes)
+{
+    int n = fine.sites.size() / 4;
+    if(n < MULTISCALE_MIN_SITES || std::min(fine.source.width, fine.source.height) < 2*MULTISCALE_MIN_SIDE) return false;
+
+    downsample(fine.source, coarse.source);
+    downsample(fine.target, coarse.target);
+    int width = coarse.target.width, height = coarse.target.height;
+
+    // the Lloyd iterations start from evenly taken finer sites
+    std::vector< std::pair<double, double> > sites(n);
+    for(int k = 0; k < n; k++) {
+        sites[k] = coarsen(fine.sites[(long)k * fine.sites.size() / n], coarse.target);
+    }
+    LloydQuantizer quantizer(coarse.target, backend);
+    quantizer.run(sites, lloyd);
+    passes += quantizer.passes;
+
+    // each finer site gives its mass to the cell it lies in
+    Rasterizer rasterizer;
+    rasterizer.setup(quantizer.diagram(), width, height);
+    std::vector< int > parent(fine.sites.size()), children(n, 0);
+    std::vector< double > masses(n, 0.);
+    for(int i = 0; i < (int)fine.sites.size(); i++) {
+        std::pair<double, double> p = coarsen(fine.sites[i], coarse.target);
+        int x = std::min((int)floor(p.first + 0.5), width-1), y = std::min((int)floor(p.second + 0.5), height-1);
+        parent[i] = rasterizer.locate(x, y);
+        masses[parent[i]] += fine.masses[i];
+        children[parent[i]]++;
+    }
+
+    // sites owning no finer site are dropped
+    std::vector< int > index(n, -1);
+    coarse.sites.clear();
+    coarse.masses.clear();
+    for(int j = 0; j < n; j++) {
+        if(children[j] == 0) continue;
+        index[j] = coarse.sites.size();
+        coarse.sites.push_back(sites[j]);
+        coarse.masses.push_back(masses[j]);
+    }
+    coarse.parent.resize(fine.sites.size());
+    for(int i = 0; i < (int)fine.sites.size(); i++) {
+        coarse.parent[i] = index[parent[i]];
+    }
+
+    return coarse.sites.size() >= MULTISCALE_MIN_SITES;
+}
+
+// the prolonged weights leave some cells empty, which the Newton steps cannot
+// grow: they are scaled towards equal weights, halving them until no cell is
+// empty. Even equal weights leave a cell empty when its Voronoi cell holds no
+// pixel center, the last round then keeps them and the conjugate gradient
+// moves that weight on its own; ws maps pd on return
+static void fill_empty_cells(const Image &source, PowerDiagram &pd, MappingWorkspace &ws)
+{
+    std::vector< double > prolonged = pd.weights, weights(pd.nb_sites);
+    for(int round = 0; round <= MULTISCALE_FILL_ROUNDS; round++) {
+        generate_mapping(source, pd, ws, MAPPING_LABELS | MAPPING_MASSES | MAPPING_INCREMENTAL);
+        int empty = 0;
+        for(int i = 0; i < pd.nb_sites; i++) {
+            empty += (ws.site_count[i] == 0);
+        }
+        if(empty == 0 || round == MULTISCALE_FILL_ROUNDS) return;
+
+        double t = (round+1 < MULTISCALE_FILL_ROUNDS) ? ldexp(1., -(round+1)) : 0.;
+        for(int i = 0; i < pd.nb_sites; i++) {
+            weights[i] = t * prolonged[i];
+        }
+        pd.update_weights(weights);
+    }
+}
+
+// optimises the weights of a coarse level from the given ones, and gives the
+// gradient of the weights to extend around each site; returns the mapping
+// passes made
+static int solve_level(const Level &level, const MultiscaleSettings &settings, PowerBackend backend,
+                       std::vector< double > &weights, std::vector< std::pair<double, double> > &gradients)
+{
+    const Image &source = level.source;
+    int N = level.sites.size();
+    double x_range = source.width, y_range = source.height;
+
+    MappingWorkspace ws(source.width, source.height, N);
+    PowerDiagram *pd = new PowerDiagram(level.sites, weights, x_range, y_range, backend);
+    PowerDiagram *trial = new PowerDiagram(level.sites, weights, x_range, y_range, backend);
+    fill_empty_cells(source, *pd, ws);
+    std::vector< double > masses = ws.site_weight;
+
+    double source_total_mass = 0., target_total_mass = 0.;
+    for(int p = 0; p < N; p++) {
+        source_total_mass += masses[p];
+        target_total_mass += level.masses[p];
+    }
+
+    std::vector< double > target_masses(N);
+    double min_mass = *std::min_element(masses.begin(), masses.end());
+    for(int p = 0; p < N; p++) {
+        target_masses[p] = level.masses[p]/target_total_mass*source_total_mass;
+        min_mass = std::min(min_mass, target_masses[p]);
+    }
+    min_mass /= 2;
+
+    NewtonWorkspace newton;
+    int iter = 0;
+    for(; iter < settings.max_iter; iter++) {
+        double residual = 0;
+        for(int p = 0; p < N; p++) {
+            residual = std::max(residual, fabs(target_masses[p] - masses[p])/source_total_mass);
+        }
+        if(residual * N <= settings.residual_tolerance) break;
+        if(!newton_step(source, target_masses, min_mass, pd, trial, ws, newton, masses)) break;
+    }
+    weights = pd->weights;
+    if(verbosity >= 1) std::cout << "Level of " << N << " sites solved in " << iter << " iterations" << std::endl;
+
+    // a rejected trial may be the last diagram mapped
+    generate_mapping(source, *pd, ws, MAPPING_LABELS | MAPPING_MASSES | MAPPING_INCREMENTAL);
+    std::vector< double > moment_x(N, 0.), moment_y(N, 0.);
+    for(int y = 0; y < source.height; y++) {
+        for(int x = 0; x < source.width; x++) {
+            int site = ws.pix_to_site[y*source.width + x];
+            moment_x[site] += x;
+            moment_y[site] += y;
+        }
+    }
+
+    // w(y) = -2 t.y translates the Voronoi cells of sites around y by t, so
+    // this gradient brings the cells of the finer sites over the cell of
+    // their parent, from the parent to the centroid of its cell
+    gradients.resize(N);
+    for(int p = 0; p < N; p++) {
+        if(ws.site_count[p] == 0) {
+            gradients[p] = std::make_pair(0., 0.);
+        } else {
+            gradients[p] = std::make_pair(2*(level.sites[p].first - moment_x[p]/ws.site_count[p]), 2*(level.sites[p].second - moment_y[p]/ws.site_count[p]));
+        }
+    }
+
+    delete pd;
+    delete trial;
+    return ws.passes;
+}
+
+int multiscale_weights(const Image &source, const Image &target, const std::vector< std::pair<double, double> > &sites,
+                       const std::vector< double > &masses, const MultiscaleSettings &settings, const LloydSettings &lloyd,
+                       PowerBackend backend, std::vector< double > &weights)
+{
+    weights.assign(sites.size(), 0.);
+
+    int passes = 0;
+    std::vector< Level > levels(1);
+    levels[0].source = source;
+    levels[0].target = target;
+    levels[0].sites = sites;
+    levels[0].masses = masses;
+    while((int)levels.size() <= settings.levels) {
+        Level coarse;
+        if(!build_level(levels.back(), lloyd, backend, coarse, passes)) break;
+        levels.push_back(coarse);
+    }
+    if(verbosity >= 1) std::cout << "Solving " << levels.size()-1 << " coarse levels before the full resolution" << std::endl;
+    if(levels.size() == 1) return passes;
+
+    std::vector< double > coarse_weights(levels.back().sites.size(), 0.);
+    std::vector< std::pair<double, double> > gradients;
+    for(int l = levels.size()-1; l > 0; l--) {
+        const Level &coarse = levels[l];
+        const Level &fine = levels[l-1];
+        passes += solve_level(coarse, settings, backend, coarse_weights, gradients);
+
+        // the weights of a parent are extended linearly to its finer sites,
+        // so that they split its cell as a translated Voronoi diagram would;
+        // the power distances scale by 4 from one level to the finer one
+        std::vector< double > fine_weights(fine.sites.size());
+        for(int i = 0; i < (int)fine.sites.size(); i++) {
+            int j = coarse.parent[i];
+            std::pair<double, double> p = coarsen(fine.sites[i], coarse.source);
+            const std::pair<double, double> &s = coarse.sites[j];
+            fine_weights[i] = 4 * (coarse_weights[j] + gradients[j].first * (p.first - s.first) + gradients[j].second * (p.second - s.second));
+        }
+        coarse_weights.swap(fine_weights);
+    }
+
+    // the full resolution starts from non-empty cells as well
+    MappingWorkspace ws(source.width, source.height, sites.size());
+    PowerDiagram pd(sites, coarse_weights, source.width, source.height, backend);
+    fill_empty_cells(source, pd, ws);
+    weights = pd.weights;
+    return passes + ws.passes;
+}
@@ -0,0 +1,36 @@
+#ifndef multiscale_h_INCLUDED
+#define multiscale_h_INCLUDED
+
+#include <vector>
+#include <utility>
+
+#include "image.h"
+#include "power_diagram.h"
+#include "lloyd.h"
+
+/* Coarse-to-fine warm start of the transport weights. The source and the
+   target are halved levels times; each level is quantized by a quarter of
+   the sites of the finer one, by Lloyd iterations from a subset of them, and
+   each coarse site carries the target mass of the finer sites lying in its
+   cell. The weights are optimised from the coarsest level up, each level
+   starting from the weights of the coarser one */
+struct MultiscaleSettings
+{
+    // number of coarse levels, 0 starts the full resolution from equal weights
+    int levels = 0;
+    // iteration cap and mass residual tolerance (as in StoppingCriteria) of
+    // the weight optimisation at each coarse level
+    int max_iter = 50;
+    double residual_tolerance = 0.05;
+};
+
+/* Fills weights with the warm start of the transport from source to the
+   sites (quantizing target, with the given target masses) that the coarse
+   levels give; the coarse sites are placed as asked by lloyd. Returns the
+   number of mapping passes made, those quantizing the coarse levels
+   included */
+int multiscale_weights(const Image &source, const Image &target, const std::vector< std::pair<double, double> > &sites,
+                       const std::vector< double > &masses, const MultiscaleSettings &settings, const LloydSettings &lloyd,
+                       PowerBackend backend, std::vector< double > &weights);
+
+#endif // multiscale_h_INCLUDED
@@ -8,64 +8,326 @@
 
 #include "power_diagram.h"
 
+// vertices reserved for each cell, power cells rarely have more than that
+#define POWER_CELL_CAPACITY 16
+
 PowerDiagram::PowerDiagram()
 {
+    backend = POWER_LIFTED;
     nb_sites = 0;
     lifting_constant = 0;
+    radius_offset = 0;
+    x_range = 1.;
+    y_range = 1.;
+    grid_nx = 0;
+    grid_ny = 0;
     container = new voro::container(0.,1.,0.,1.,0.,1., 1, 1, 1, false, false, false, 1);
 }
 
-PowerDiagram::PowerDiagram(std::vector< std::pair<double, double> > s, std::vector< double > w, double x_range, double y_range)
+PowerDiagram::PowerDiagram(const std::vector< std::pair<double, double> > &s, const std::vector< double > &w, double x_r, double y_r, PowerBackend b)
 {
+    backend = b;
     nb_sites = s.size();
     sites = s;
     weights = w;
+    x_range = x_r;
+    y_range = y_r;
+    lifting_constant = 0;
+    radius_offset = 0;
+    grid_nx = 0;
+    grid_ny = 0;
+
+    if(backend == POWER_LIFTED) {
+        build_lifted_container();
+    } else if(backend == POWER_RADICAL) {
+        build_radical_container();
+    } else {
+        build_block_grid();
+    }
+
+    get_projection();
+}
+
+void PowerDiagram::build_lifted_container()
+{
+    delete container;
 
     // to ensure that we will not compute square roots of non-positive numbers
     lifting_constant = 2 * std::max(*max_element(weights.begin(),weights.end()), - *min_element(weights.begin(),weights.end()));
+    // all weights are zero for a plain Voronoi diagram, keep a non-flat container
+    if(lifting_constant <= 0) lifting_constant = 1;
 
-    // create the container
-    container = new voro::container (0., x_range, 0., y_range, 0., sqrt(2*lifting_constant), 1, 1, 1, false,false,false, nb_sites);
+    // create the container, with a block grid sized so that locating the
+    // cell of a point only visits a few neighbouring blocks
+    int nx, ny;
+    guess_optimal_grid(nb_sites, x_range, y_range, nx, ny);
+    container = new voro::container (0., x_range, 0., y_range, 0., sqrt(2*lifting_constant), nx, ny, 1, false,false,false, 8);
 
     // we will add the lifted points to a container
     // remember that the lifting is (x, y) -> (x, y, sqrt(c - w)) 
     for(int i = 0; i < nb_sites; i++) {
-        container->put(i, s[i].first, s[i].second, sqrt(lifting_constant - w[i]));
+        container->put(i, sites[i].first, sites[i].second, sqrt(lifting_constant - weights[i]));
+    }
+}
+
+void PowerDiagram::build_radical_container()
+{
+    // the radical distance to a site of radius r is |p - s|^2 - r^2, so
+    // shift the weights to get non-negative squared radii
+    radius_offset = nb_sites > 0 ? - *min_element(weights.begin(), weights.end()) : 0;
+
+    // all the sites lie in the plane z = 0 of a slab of fixed thickness,
+    // whose cells are prisms over the power cells
+    int nx, ny;
+    guess_optimal_grid(nb_sites, x_range, y_range, nx, ny);
+    radical_container = new voro::container_poly(0., x_range, 0., y_range, -0.5, 0.5, nx, ny, 1, false, false, false, 8);
+    for(int i = 0; i < nb_sites; i++) {
+        radical_container->put(i, sites[i].first, sites[i].second, 0., sqrt(weights[i] + radius_offset));
     }
-    container->draw_cells_gnuplot("cells.gnu");
+}
+
+void PowerDiagram::build_block_grid()
+{
+    // bucket the sites in a grid of blocks, as voro++ does
+    guess_optimal_grid(nb_sites, x_range, y_range, grid_nx, grid_ny);
+    block_offset.assign(grid_nx*grid_ny + 1, 0);
+    block_sites.resize(nb_sites);
+
+    std::vector< int > site_block(nb_sites);
+    for(int i = 0; i < nb_sites; i++) {
+        int bx = std::min(std::max((int)(sites[i].first / x_range * grid_nx), 0), grid_nx-1);
+        int by = std::min(std::max((int)(sites[i].second / y_range * grid_ny), 0), grid_ny-1);
+        site_block[i] = by*grid_nx + bx;
+        block_offset[site_block[i]+1]++;
+    }
+    for(int b = 0; b < grid_nx*grid_ny; b++) {
+        block_offset[b+1] += block_offset[b];
+    }
+    std::vector< int > cursor(block_offset.begin(), block_offset.end() - 1);
+    for(int i = 0; i < nb_sites; i++) {
+        block_sites[cursor[site_block[i]]++] = i;
+    }
+}
+
+void PowerDiagram::update_weights(const std::vector< double > &w)
+{
+    std::copy(w.begin(), w.end(), weights.begin());
+
+    if(backend == POWER_LIFTED && nb_sites > 0) {
+        double w_min = *min_element(weights.begin(), weights.end());
+        double w_max = *max_element(weights.begin(), weights.end());
+        if(w_max <= lifting_constant && -w_min <= lifting_constant) {
+            // the lifted points stay in [0, sqrt(2c)], and the container has
+            // a single layer of blocks along z: only their heights change
+            for(int b = 0; b < container->nxyz; b++) {
+                for(int q = 0; q < container->co[b]; q++) {
+                    container->p[b][3*q+2] = sqrt(lifting_constant - weights[container->id[b][q]]);
+                }
+            }
+        } else {
+            build_lifted_container();
+        }
+    } else if(backend == POWER_RADICAL && nb_sites > 0) {
+        // the slab does not depend on the weights, only the radii change
+        radius_offset = - *min_element(weights.begin(), weights.end());
+        radical_container->max_radius = 0;
+        for(int b = 0; b < radical_container->nxyz; b++) {
+            for(int q = 0; q < radical_container->co[b]; q++) {
+                double r = sqrt(weights[radical_container->id[b][q]] + radius_offset);
+                radical_container->p[b][4*q+3] = r;
+                radical_container->max_radius = std::max(radical_container->max_radius, r);
+            }
+        }
+    }
+
+    get_projection();
 }
 
 void PowerDiagram::get_projection()
 {
-    sites_edges = std::vector< std::vector < std::pair<double, double> >  >(nb_sites, std::vector< std::pair<double, double> >());
-
-    if(container != NULL) {
-        voro::c_loop_all cla(*container);
-        voro::voronoicell c;
-        int i;
-        double x,y,z,r;
-        if(cla.start()) do if (container->compute_cell(c,cla)) {
-            int relevant_vertex = c.p;
-            // Get the position and ID information for the particle
-            // currently being considered by the loop. Ignore the radius
-            // information.
-            cla.pos(i,x,y,z,r);
-
-            for(int j = 0; j < relevant_vertex; j++) {
-                double v_x = x + 0.5*c.pts[3*j];
-                double v_y = y + 0.5*c.pts[3*j+1];
-                double v_z = z + 0.5*c.pts[3*j+2];
-
-                if(abs(v_z) <= 1e-10) {
-                    // consider that v_z = 0
-                    sites_edges[i].push_back(std::make_pair(v_x, v_y));
+    // keep the polygons' storage from one diagram to the next
+    sites_edges.resize(nb_sites);
+    sites_neighbors.resize(nb_sites);
+    for(int i = 0; i < nb_sites; i++) {
+        sites_edges[i].clear();
+        sites_neighbors[i].clear();
+        sites_edges[i].reserve(POWER_CELL_CAPACITY);
+        sites_neighbors[i].reserve(POWER_CELL_CAPACITY);
+    }
+
+    if(backend == POWER_LIFTED) {
+        if(container != NULL) compute_voro_cells(*container);
+    } else if(backend == POWER_RADICAL) {
+        if(radical_container != NULL) compute_voro_cells(*radical_container);
+    } else {
+        compute_native_cells();
+    }
+}
+
+template <class c_class>
+void PowerDiagram::compute_voro_cells(c_class &con)
+{
+    voro::c_loop_all cla(con);
+    if(cla.start()) do if (con.compute_cell(voro_cell,cla)) {
+        // the 3D cell meets the plane of the sites (z = 0 for the lifted
+        // points) along the power cell of the site, which is therefore
+        // only bounded by the power bisectors with its 3D neighbours
+        int i = cla.pid();
+        voro_cell.neighbors(voro_neighbors);
+        init_cell(i);
+        for(int j : voro_neighbors) {
+            if(j >= 0) clip_cell(i, j);
+        }
+    } while (cla.inc());
+}
+
+void PowerDiagram::compute_native_cells()
+{
+    if(nb_sites == 0) return;
+
+    double max_weight = *max_element(weights.begin(), weights.end());
+    double block_width = x_range / grid_nx;
+    double block_height = y_range / grid_ny;
+
+    for(int i = 0; i < nb_sites; i++) {
+        init_cell(i);
+
+        int bx = std::min(std::max((int)(sites[i].first / block_width), 0), grid_nx-1);
+        int by = std::min(std::max((int)(sites[i].second / block_height), 0), grid_ny-1);
+
+        // visit the blocks ring by ring around the block of i
+        for(int r = 0; ; r++) {
+            int x_begin = bx - r, x_end = bx + r, y_begin = by - r, y_end = by + r;
+            for(int y = std::max(y_begin, 0); y <= std::min(y_end, grid_ny-1); y++) {
+                // inner rows of the ring only have their two end blocks
+                int step = (y == y_begin || y == y_end) ? 1 : std::max(x_end - x_begin, 1);
+                for(int x = x_begin; x <= x_end; x += step) {
+                    if(x < 0 || x >= grid_nx) continue;
+                    int b = y*grid_nx + x;
+                    for(int k = block_offset[b]; k < block_offset[b+1]; k++) {
+                        if(block_sites[k] != i) clip_cell(i, block_sites[k]);
+                    }
                 }
             }
-        } while (cla.inc());
+
+            const std::vector< std::pair<double, double> > &polygon = sites_edges[i];
+            if(polygon.empty()) break;
+            if(x_begin <= 0 && y_begin <= 0 && x_end >= grid_nx-1 && y_end >= grid_ny-1) break;
+
+            // a site beyond the ring is at least as far from a vertex v as the
+            // sides of the ring which are inside the domain, it cannot cut the
+            // cell if even the heaviest site would be further than v's power
+            double x_lo = (x_begin > 0) ? x_begin * block_width : -1e300;
+            double x_hi = (x_end < grid_nx-1) ? (x_end+1) * block_width : 1e300;
+            double y_lo = (y_begin > 0) ? y_begin * block_height : -1e300;
+            double y_hi = (y_end < grid_ny-1) ? (y_end+1) * block_height : 1e300;
+
+            bool complete = true;
+            for(const std::pair<double, double> &v : polygon) {
+                double d = std::min(std::min(v.first - x_lo, x_hi - v.first), std::min(v.second - y_lo, y_hi - v.second));
+                if(d*d - max_weight <= power(i, v.first, v.second)) {
+                    complete = false;
+                    break;
+                }
+            }
+            if(complete) break;
+        }
+    }
+}
+
+void PowerDiagram::init_cell(int i)
+{
+    // start from the domain, labelled with voro++ wall ids
+    sites_edges[i] = {std::make_pair(0., 0.), std::make_pair(x_range, 0.), std::make_pair(x_range, y_range), std::make_pair(0., y_range)};
+    sites_neighbors[i] = {-3, -2, -4, -1};
+}
+
+void PowerDiagram::clip_cell(int i, int j)
+{
+    std::vector< std::pair<double, double> > &polygon = sites_edges[i];
+    std::vector< int > &labels = sites_neighbors[i];
+    if(polygon.empty() || j == i) return;
+
+    // the cell of i lies in the half-plane a.p <= b
+    double xi = sites[i].first, yi = sites[i].second;
+    double xj = sites[j].first, yj = sites[j].second;
+    double ax = 2*(xj - xi), ay = 2*(yj - yi);
+    double b = xj*xj + yj*yj - xi*xi - yi*yi + weights[i] - weights[j];
+
+    int nb_vertices = polygon.size();
+    bool outside = false;
+    clip_dist.resize(nb_vertices);
+    for(int k = 0; k < nb_vertices; k++) {
+        clip_dist[k] = ax*polygon[k].first + ay*polygon[k].second - b;
+        outside |= (clip_dist[k] > 0);
+    }
+    if(!outside) return;
+
+    clipped.clear();
+    clipped_labels.clear();
+    for(int k = 0; k < nb_vertices; k++) {
+        int l = (k+1) % nb_vertices;
+        double t = clip_dist[k] / (clip_dist[k] - clip_dist[l]);
+        std::pair<double, double> cut = std::make_pair(polygon[k].first + t*(polygon[l].first - polygon[k].first),
+                                                       polygon[k].second + t*(polygon[l].second - polygon[k].second));
+        if(clip_dist[k] <= 0) {
+            clipped.push_back(polygon[k]);
+            clipped_labels.push_back(labels[k]);
+            if(clip_dist[l] > 0) {
+                // leaving the half-plane, follow the bisector
+                clipped.push_back(cut);
+                clipped_labels.push_back(j);
+            }
+        } else if(clip_dist[l] <= 0) {
+            // entering the half-plane back
+            clipped.push_back(cut);
+            clipped_labels.push_back(labels[k]);
+        }
+    }
+
+    if(clipped.size() < 3) {
+        clipped.clear();
+        clipped_labels.clear();
+    }
+    // copied rather than swapped, so that each cell keeps its own storage
+    // and updating the weights does not allocate
+    polygon.assign(clipped.begin(), clipped.end());
+    labels.assign(clipped_labels.begin(), clipped_labels.end());
+}
+
+double PowerDiagram::power(int i, double x, double y) const
+{
+    double dx = x - sites[i].first;
+    double dy = y - sites[i].second;
+    return dx*dx + dy*dy - weights[i];
+}
+
+void guess_optimal_grid(int nb_sites, double x_range, double y_range, int &nx, int &ny)
+{
+    // this is voro::pre_container::guess_optimal restricted to the plane: all
+    // the sites are spread along x and y only (the lifted coordinate does not
+    // separate them), so a single layer of blocks is used along z
+    double ilscale = sqrt(nb_sites / (voro::optimal_particles * x_range * y_range));
+    nx = std::max(1, (int)(x_range * ilscale + 1));
+    ny = std::max(1, (int)(y_range * ilscale + 1));
+}
+
+bool parse_power_backend(const std::string &name, PowerBackend &backend)
+{
+    if(name == "lifted") {
+        backend = POWER_LIFTED;
+    } else if(name == "native") {
+        backend = POWER_NATIVE;
+    } else if(name == "radical") {
+        backend = POWER_RADICAL;
+    } else {
+        return false;
     }
+    return true;
 }
 
 PowerDiagram::~PowerDiagram()
 {
     delete container;
+    delete radical_container;
 }
@@ -1,24 +1,96 @@
 #ifndef power_diagram_h_INCLUDED
 #define power_diagram_h_INCLUDED
 
+#include <string>
+
 #include "../libs/include/voro++/voro++.hh"
 
+/* How the power cells are computed */
+enum PowerBackend
+{
+    // each site is lifted to (x, y, sqrt(c - w)) in a voro::container, and
+    // the 3D Voronoi cells give the neighbours of the 2D cells
+    POWER_LIFTED,
+    // the domain is clipped in 2D by the power bisectors with the nearby
+    // sites, found through a grid of blocks
+    POWER_NATIVE,
+    // radical tessellation of a voro::container_poly, the weights being the
+    // squared radii of sites lying in a flat slab
+    POWER_RADICAL
+};
+
 class PowerDiagram
 {
     public:
+        PowerBackend backend;
         int nb_sites;
         float lifting_constant;
+        double x_range;
+        double y_range;
         std::vector< std::pair<double, double> > sites;
-        std::vector< double > weights; 
+        std::vector< double > weights;
         voro::container *container = NULL;
+        // container of the radical backend, whose bounds do not depend on
+        // the weights; the radius of the site i is sqrt(w_i + radius_offset)
+        voro::container_poly *radical_container = NULL;
+        double radius_offset;
+
+        // power cell of each site, as a counter-clockwise convex polygon,
+        // and the site lying across each of its edges (edge k goes from
+        // vertex k to vertex k+1, negative ids are the domain boundaries)
         std::vector< std::vector< std::pair<double, double> > > sites_edges;
+        std::vector< std::vector< int > > sites_neighbors;
 
         PowerDiagram();
-        PowerDiagram(std::vector< std::pair<double, double> > s, std::vector< double > w, double x_range, double y_range);
+        PowerDiagram(const std::vector< std::pair<double, double> > &s, const std::vector< double > &w, double x_range, double y_range, PowerBackend backend = POWER_NATIVE);
 
         void get_projection();
 
+        /* Replaces the weights, the sites being unchanged, and recomputes
+           the cells; the containers are updated in place rather than rebuilt
+           whenever their bounds allow it */
+        void update_weights(const std::vector< double > &w);
+
+        /* Power distance from (x, y) to the site i */
+        double power(int i, double x, double y) const;
+
         ~PowerDiagram();
+
+    private:
+        // grid of blocks of the native backend, the sites of the block
+        // (bx, by) are block_sites[block_offset[b]] ... block_sites[block_offset[b+1]-1]
+        // with b = by*grid_nx + bx
+        int grid_nx;
+        int grid_ny;
+        std::vector< int > block_offset;
+        std::vector< int > block_sites;
+
+        // cell and neighbour list reused by compute_voro_cells
+        voro::voronoicell_neighbor voro_cell;
+        std::vector< int > voro_neighbors;
+
+        // scratch buffers of clip_cell
+        std::vector< std::pair<double, double> > clipped;
+        std::vector< int > clipped_labels;
+        std::vector< double > clip_dist;
+
+        void build_lifted_container();
+        void build_radical_container();
+        void build_block_grid();
+
+        template <class c_class>
+        void compute_voro_cells(c_class &con);
+        void compute_native_cells();
+
+        void init_cell(int i);
+        void clip_cell(int i, int j);
 };
 
+/* Chooses the block grid of a container holding nb_sites sites spread over
+   [0, x_range] x [0, y_range], aiming at voro::optimal_particles sites per block */
+void guess_optimal_grid(int nb_sites, double x_range, double y_range, int &nx, int &ny);
+
+/* Parses "lifted", "native" or "radical", returns false for other names */
+bool parse_power_backend(const std::string &name, PowerBackend &backend);
+
 #endif // power_diagram_h_INCLUDED
@@ -0,0 +1,179 @@
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "power_diagram.h"
+#include "rasterizer.h"
+
+// tolerance used to catch the pixels lying on a cell boundary
+#define RASTER_EPS 1e-7
+
+// claims the pixel for the site i, unless it is already owned by a site
+// with a smaller power distance (ties go to the smallest id)
+static inline void claim(const PowerDiagram &pd, int i, double x, double y, int &owner)
+{
+    if(owner < 0) {
+        owner = i;
+        return;
+    }
+    double pi = pd.power(i, x, y);
+    double po = pd.power(owner, x, y);
+    if(pi < po || (pi == po && i < owner)) owner = i;
+}
+
+Rasterizer::Rasterizer()
+{
+    pd = NULL;
+    width = 0;
+    height = 0;
+}
+
+static bool span_order(const RowSpan &a, const RowSpan &b)
+{
+    return a.begin < b.begin || (a.begin == b.begin && a.site < b.site);
+}
+
+void Rasterizer::setup(const PowerDiagram &diagram, int w, int h)
+{
+    pd = &diagram;
+    width = w;
+    height = h;
+
+    // spans are first computed cell by cell, then bucketed by row
+    cell_spans.clear();
+    cell_spans_row.clear();
+    row_offset.assign(height+1, 0);
+
+    for(int i = 0; i < pd->nb_sites; i++) {
+        const std::vector< std::pair<double, double> > &polygon = pd->sites_edges[i];
+        int nb_vertices = polygon.size();
+        if(nb_vertices < 3) continue;
+
+        double y_min = polygon[0].second, y_max = polygon[0].second;
+        for(const std::pair<double, double> &v : polygon) {
+            y_min = std::min(y_min, v.second);
+            y_max = std::max(y_max, v.second);
+        }
+
+        int row_begin = std::max(0, (int)ceil(y_min - RASTER_EPS));
+        int row_end = std::min(height-1, (int)floor(y_max + RASTER_EPS));
+
+        for(int y = row_begin; y <= row_end; y++) {
+            // the polygon is convex, so the row crosses it along one span
+            double x_left = std::numeric_limits<double>::max();
+            double x_right = -std::numeric_limits<double>::max();
+            for(int k = 0; k < nb_vertices; k++) {
+                const std::pair<double, double> &a = polygon[k];
+                const std::pair<double, double> &b = polygon[(k+1) % nb_vertices];
+                if(std::min(a.second, b.second) > y + RASTER_EPS || std::max(a.second, b.second) < y - RASTER_EPS) continue;
+
+                double x_lo = std::min(a.first, b.first), x_hi = std::max(a.first, b.first);
+                if(fabs(b.second - a.second) <= RASTER_EPS) {
+                    x_left = std::min(x_left, x_lo);
+                    x_right = std::max(x_right, x_hi);
+                } else {
+                    double x = a.first + (y - a.second) * (b.first - a.first) / (b.second - a.second);
+                    x = std::min(std::max(x, x_lo), x_hi);
+                    x_left = std::min(x_left, x);
+                    x_right = std::max(x_right, x);
+                }
+            }
+
+            RowSpan span;
+            span.site = i;
+            span.begin = std::max(0, (int)ceil(x_left - RASTER_EPS));
+            span.end = std::min(width-1, (int)floor(x_right + RASTER_EPS));
+            if(span.begin > span.end) continue;
+
+            // an endpoint within the tolerance of a pixel may be shared
+            span.ambiguous_begin = (ceil(x_left - RASTER_EPS) != ceil(x_left + RASTER_EPS));
+            span.ambiguous_end = (floor(x_right + RASTER_EPS) != floor(x_right - RASTER_EPS));
+
+            cell_spans.push_back(span);
+            cell_spans_row.push_back(y);
+            row_offset[y+1]++;
+        }
+    }
+
+    for(int y = 0; y < height; y++) {
+        row_offset[y+1] += row_offset[y];
+    }
+
+    spans.resize(cell_spans.size());
+    for(int k = 0; k < (int)cell_spans.size(); k++) {
+        spans[row_offset[cell_spans_row[k]]++] = cell_spans[k];
+    }
+
+    for(int y = height; y > 0; y--) {
+        row_offset[y] = row_offset[y-1];
+    }
+    row_offset[0] = 0;
+
+    gaps.clear();
+    for(int y = 0; y < height; y++) {
+        std::sort(spans.begin() + row_offset[y], spans.begin() + row_offset[y+1], span_order);
+
+        int covered = -1;
+        for(int k = row_offset[y]; k < row_offset[y+1]; k++) {
+            if(spans[k].begin > covered+1) {
+                gaps.push_back(y);
+                gaps.push_back(covered+1);
+                gaps.push_back(spans[k].begin-1);
+            }
+            covered = std::max(covered, spans[k].end);
+        }
+        if(covered < width-1) {
+            gaps.push_back(y);
+            gaps.push_back(covered+1);
+            gaps.push_back(width-1);
+        }
+    }
+}
+
+void Rasterizer::rasterize_row(int y, int *labels) const
+{
+    std::fill(labels, labels + width, -1);
+
+    for(int k = row_offset[y]; k < row_offset[y+1]; k++) {
+        const RowSpan &span = spans[k];
+        for(int x = span.begin; x <= span.end; x++) {
+            claim(*pd, span.site, x, y, labels[x]);
+        }
+    }
+
+    // pixels missed by every span (numerical corner cases) are located by hand
+    for(int x = 0; x < width; x++) {
+        if(labels[x] >= 0) continue;
+        for(int i = 0; i < pd->nb_sites; i++) {
+            claim(*pd, i, x, y, labels[x]);
+        }
+    }
+}
+
+int Rasterizer::locate(int x, int y) const
+{
+    int owner = -1;
+
+    // last span starting at or before x, the spans covering x end there
+    // since spans of a row only overlap on shared endpoints
+    const RowSpan *first = spans.data() + row_offset[y];
+    const RowSpan *last = spans.data() + row_offset[y+1];
+    RowSpan key;
+    key.begin = x;
+    key.site = pd->nb_sites;
+    const RowSpan *k = std::upper_bound(first, last, key, span_order);
+    while(k != first) {
+        --k;
+        if(k->end < x - 1) break;
+        if(k->end >= x) claim(*pd, k->site, x, y, owner);
+    }
+
+    if(owner < 0) {
+        for(int i = 0; i < pd->nb_sites; i++) {
+            claim(*pd, i, x, y, owner);
+        }
+    }
+    return owner;
+}
@@ -0,0 +1,54 @@
+#ifndef rasterizer_h_INCLUDED
+#define rasterizer_h_INCLUDED
+
+#include <vector>
+
+#include "power_diagram.h"
+
+/* Pixels [begin, end] of a row covered by the cell of site. Spans of
+   neighbouring cells may share an endpoint pixel lying on their common
+   boundary, such endpoints are flagged as ambiguous */
+struct RowSpan
+{
+    int site;
+    int begin;
+    int end;
+    bool ambiguous_begin;
+    bool ambiguous_end;
+};
+
+/* Scan-converts the power cells of a diagram row by row. setup() computes
+   the span of every cell on every row it crosses, then rasterize_row()
+   writes the site owning each pixel of a row; rows can be produced in any
+   order */
+class Rasterizer
+{
+    public:
+        int width;
+        int height;
+
+        // spans of the row y, sorted by begin, are
+        // spans[row_offset[y]] ... spans[row_offset[y+1]-1]
+        std::vector< int > row_offset;
+        std::vector< RowSpan > spans;
+        // (y, x_begin, x_end) runs of pixels covered by no span, which are
+        // labelled by testing every site
+        std::vector< int > gaps;
+
+        Rasterizer();
+
+        void setup(const PowerDiagram &pd, int width, int height);
+
+        /* Writes in labels[x] the site owning the pixel (x, y) */
+        void rasterize_row(int y, int *labels) const;
+
+        /* Site owning the single pixel (x, y), as rasterize_row would find it */
+        int locate(int x, int y) const;
+
+    private:
+        const PowerDiagram *pd;
+        std::vector< RowSpan > cell_spans;
+        std::vector< int > cell_spans_row;
+};
+
+#endif // rasterizer_h_INCLUDED
@@ -0,0 +1,183 @@
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+
+#include <omp.h>
+
+#include "renderer.h"
+
+FrameRenderer::FrameRenderer(const Image &s, const std::vector< std::pair<double, double> > &sites_, double x_r, double y_r, PowerBackend b)
+    : source(s), sites(sites_), x_range(x_r), y_range(y_r), backend(b)
+{
+    incremental = true;
+}
+
+FrameRenderer::~FrameRenderer()
+{
+    for(PowerDiagram *pd : diagrams) {
+        delete pd;
+    }
+}
+
+void FrameRenderer::render(const std::vector< double > &w, const std::vector< double > &times, const std::function<void(int, Image &)> &consume)
+{
+    int N = sites.size();
+    int nb_frames = times.size();
+    if(nb_frames == 0) return;
+    int nb_slots = std::min(omp_get_max_threads(), nb_frames);
+
+    // the slots are only built once, then updated in place
+    for(int slot = diagrams.size(); slot < nb_slots; slot++) {
+        diagrams.push_back(new PowerDiagram(sites, std::vector<double>(N, 0.), x_range, y_range, backend));
+        workspaces.push_back(MappingWorkspace(source.width, source.height, N));
+        scaled_weights.push_back(std::vector<double>(N));
+    }
+
+    int outputs = MAPPING_LABELS | MAPPING_MASSES;
+    if(incremental) outputs |= MAPPING_INCREMENTAL;
+
+    // a frame is a whole mapping, so the frames are spread over the threads
+    // and each mapping runs on a single one; a thread renders a run of
+    // consecutive times so that each frame is close to its previous one
+    #pragma omp parallel num_threads(nb_slots)
+    {
+        int slot = omp_get_thread_num();
+        int nb_threads = omp_get_num_threads();
+        int begin = (long)nb_frames * slot / nb_threads;
+        int end = (long)nb_frames * (slot+1) / nb_threads;
+        for(int k = begin; k < end; k++) {
+            render_frame(slot, w, times[k], k, outputs, consume);
+        }
+    }
+}
+
+void FrameRenderer::render_frame(int slot, const std::vector< double > &w, double t, int k, int outputs, const std::function<void(int, Image &)> &consume)
+{
+    int N = sites.size();
+    PowerDiagram &pd = *diagrams[slot];
+    MappingWorkspace &ws = workspaces[slot];
+    std::vector< double > &weights_interp = scaled_weights[slot];
+
+    for(int i = 0; i < N; i++) {
+        weights_interp[i] = t*w[i];
+    }
+    pd.update_weights(weights_interp);
+    generate_mapping(source, pd, ws, outputs);
+
+    Image frame = Image(source.height, source.width, 1);
+    double *out = frame.channel(0);
+    for(int id = 0; id < source.width*source.height; id++) {
+        int site = ws.pix_to_site[id];
+        out[id] = ws.site_weight[site]/ws.site_count[site];
+    }
+    consume(k, frame);
+}
+
+int FrameRenderer::passes() const
+{
+    int total = 0;
+    for(const MappingWorkspace &ws : workspaces) {
+        total += ws.passes;
+    }
+    return total;
+}
+
+DisplacementRenderer::DisplacementRenderer(const Image &s) : source(s)
+{
+}
+
+void DisplacementRenderer::setup(const PowerDiagram &pd)
+{
+    int N = pd.nb_sites;
+    int width = source.width;
+    int height = source.height;
+
+    generate_mapping(source, pd, ws, MAPPING_LABELS | MAPPING_MASSES);
+
+    // barycentres of the gray mass of the cells
+    std::vector< double > moment_x(N, 0.), moment_y(N, 0.);
+    for(int y = 0; y < height; y++) {
+        const double *gs = source.row(y);
+        const int *labels = &ws.pix_to_site[y*width];
+        for(int x = 0; x < width; x++) {
+            moment_x[labels[x]] += x * gs[x];
+            moment_y[labels[x]] += y * gs[x];
+        }
+    }
+
+    origin.resize(N);
+    destination = pd.sites;
+    mass = ws.site_weight;
+    sigma.resize(N);
+    for(int i = 0; i < N; i++) {
+        if(mass[i] > 0) {
+            origin[i] = std::make_pair(moment_x[i]/mass[i], moment_y[i]/mass[i]);
+        } else {
+            origin[i] = destination[i];
+        }
+        // half the side of a square as large as the cell
+        sigma[i] = std::max(0.5, 0.5*sqrt((double)ws.site_count[i]));
+    }
+}
+
+void DisplacementRenderer::render(double t, Image &frame) const
+{
+    int N = mass.size();
+    int width = source.width;
+    int height = source.height;
+
+    if(frame.width != width || frame.height != height || frame.color != 1) {
+        frame = Image(height, width, 1);
+    }
+    std::fill(frame.data.begin(), frame.data.end(), 0.);
+
+    // each thread splats every site into its own band of rows, so that no
+    // pixel is written by two threads
+    #pragma omp parallel
+    {
+        int nb_threads = omp_get_num_threads();
+        int thread = omp_get_thread_num();
+        int band_begin = (long)height * thread / nb_threads;
+        int band_end = (long)height * (thread+1) / nb_threads;
+        std::vector< double > kernel_x, kernel_y;
+
+        for(int i = 0; i < N; i++) {
+            if(mass[i] <= 0) continue;
+
+            double cx = (1-t)*origin[i].first + t*destination[i].first;
+            double cy = (1-t)*origin[i].second + t*destination[i].second;
+            double reach = 3*sigma[i];
+            int y_begin = std::max(0, (int)ceil(cy - reach));
+            int y_end = std::min(height-1, (int)floor(cy + reach));
+            if(y_end < band_begin || y_begin >= band_end) continue;
+            int x_begin = std::max(0, (int)ceil(cx - reach));
+            int x_end = std::min(width-1, (int)floor(cx + reach));
+            if(x_begin > x_end || y_begin > y_end) continue;
+
+            // the kernel is separable, and normalised over the pixels it
+            // covers so that the site keeps its whole mass
+            double inv = -0.5 / (sigma[i]*sigma[i]);
+            double sum_x = 0, sum_y = 0;
+            kernel_x.resize(x_end - x_begin + 1);
+            kernel_y.resize(y_end - y_begin + 1);
+            for(int x = x_begin; x <= x_end; x++) {
+                kernel_x[x - x_begin] = exp(inv*(x - cx)*(x - cx));
+                sum_x += kernel_x[x - x_begin];
+            }
+            for(int y = y_begin; y <= y_end; y++) {
+                kernel_y[y - y_begin] = exp(inv*(y - cy)*(y - cy));
+                sum_y += kernel_y[y - y_begin];
+            }
+
+            double scale = mass[i] / (sum_x * sum_y);
+            for(int y = std::max(y_begin, band_begin); y <= std::min(y_end, band_end-1); y++) {
+                double *out = frame.row(y);
+                double ky = scale * kernel_y[y - y_begin];
+                for(int x = x_begin; x <= x_end; x++) {
+                    out[x] += ky * kernel_x[x - x_begin];
+                }
+            }
+        }
+    }
+}
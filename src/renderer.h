@@ -0,0 +1,86 @@
+#ifndef renderer_h_INCLUDED
+#define renderer_h_INCLUDED
+
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include "image.h"
+#include "power_diagram.h"
+#include "mapping.h"
+
+/* Renders frames of the interpolation between a source image (t = 0) and
+   its transport onto the sites (t = 1): the frame at time t paints every
+   cell of the power diagram with weights t*w with the mean gray of the
+   source under it. The times of a batch are split into contiguous runs
+   rendered in parallel; each thread keeps its own diagram and mapping
+   workspace, and as neighbouring frames mostly share their labels, it only
+   re-examines the pixels near the cell boundaries of its previous frame */
+class FrameRenderer
+{
+    public:
+        FrameRenderer(const Image &source, const std::vector< std::pair<double, double> > &sites, double x_range, double y_range, PowerBackend backend);
+        ~FrameRenderer();
+
+        // whether a frame is mapped from the previous one of its thread
+        // (default) or from scratch
+        bool incremental;
+
+        /* Renders the frame at time times[k] for the weights w and hands it
+           to consume(k, frame) as soon as it is ready; consume is called
+           from several threads at once */
+        void render(const std::vector< double > &w, const std::vector< double > &times, const std::function<void(int, Image &)> &consume);
+
+        /* Number of mapping passes made so far */
+        int passes() const;
+
+    private:
+        const Image &source;
+        std::vector< std::pair<double, double> > sites;
+        double x_range;
+        double y_range;
+        PowerBackend backend;
+
+        // per-thread diagram, workspace and scaled weights
+        std::vector< PowerDiagram* > diagrams;
+        std::vector< MappingWorkspace > workspaces;
+        std::vector< std::vector< double > > scaled_weights;
+
+        void render_frame(int slot, const std::vector< double > &w, double t, int k, int outputs, const std::function<void(int, Image &)> &consume);
+
+        FrameRenderer(const FrameRenderer &);
+        FrameRenderer &operator=(const FrameRenderer &);
+};
+
+/* Renders the displacement interpolation of McCann between a source image
+   and its transport onto the sites of a power diagram: the mass of the
+   source under each cell travels in a straight line from its barycentre to
+   the site, and is splatted with a Gaussian as wide as the cell. Once setup
+   has mapped the source, a frame costs O(N + pixels) */
+class DisplacementRenderer
+{
+    public:
+        DisplacementRenderer(const Image &source);
+
+        /* Computes the mass, barycentre and spread of the source under
+           every cell of pd */
+        void setup(const PowerDiagram &pd);
+
+        /* Renders in frame the source transported up to time t in [0, 1] */
+        void render(double t, Image &frame) const;
+
+        /* Number of mapping passes made so far */
+        int passes() const { return ws.passes; }
+
+    private:
+        const Image &source;
+        MappingWorkspace ws;
+
+        std::vector< std::pair<double, double> > origin;
+        std::vector< std::pair<double, double> > destination;
+        std::vector< double > mass;
+        // standard deviation of the kernel of each site
+        std::vector< double > sigma;
+};
+
+#endif // renderer_h_INCLUDED
@@ -0,0 +1,181 @@
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include "sampler.h"
+
+AliasTable::AliasTable()
+{
+}
+
+AliasTable::AliasTable(const std::vector< double > &weights)
+{
+    build(weights);
+}
+
+void AliasTable::build(const std::vector< double > &weights)
+{
+    int n = weights.size();
+    probability.assign(n, 1.);
+    alias.resize(n);
+    for(int i = 0; i < n; i++) {
+        alias[i] = i;
+    }
+
+    double total = 0.;
+    for(double w : weights) {
+        total += w;
+    }
+    if(n == 0 || total <= 0) return;
+
+    // scaled[i] is the share of i times n: entries below 1 are topped up by
+    // the excess of the entries above 1
+    std::vector< double > scaled(n);
+    std::vector< int > small, large;
+    for(int i = 0; i < n; i++) {
+        scaled[i] = weights[i] * n / total;
+        if(scaled[i] < 1.) {
+            small.push_back(i);
+        } else {
+            large.push_back(i);
+        }
+    }
+
+    while(!small.empty() && !large.empty()) {
+        int s = small.back(), l = large.back();
+        small.pop_back();
+        probability[s] = scaled[s];
+        alias[s] = l;
+        scaled[l] -= 1. - scaled[s];
+        if(scaled[l] < 1.) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // what remains is 1 up to rounding errors
+    for(int i : small) {
+        probability[i] = 1.;
+    }
+    for(int i : large) {
+        probability[i] = 1.;
+    }
+}
+
+int AliasTable::sample(std::mt19937 &rng) const
+{
+    std::uniform_int_distribution<int> column(0, probability.size() - 1);
+    std::uniform_real_distribution<double> coin(0., 1.);
+    int i = column(rng);
+    return (coin(rng) < probability[i]) ? i : alias[i];
+}
+
+void sample_without_replacement(const std::vector< double > &weights, int n, std::mt19937 &rng, std::vector< int > &sample)
+{
+    int size = weights.size();
+    n = std::min(n, size);
+
+    // the n largest keys log(u)/w are a weighted sample without replacement;
+    // zero weights get keys below every other one
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    std::vector< std::pair<double, int> > keys(size);
+    for(int i = 0; i < size; i++) {
+        double u = uniform(rng);
+        if(weights[i] > 0) {
+            keys[i] = std::make_pair(log(1. - u) / weights[i], i);
+        } else {
+            keys[i] = std::make_pair(-1e300 * (1. + u), i);
+        }
+    }
+
+    std::nth_element(keys.begin(), keys.begin() + n, keys.end(),
+                     [](const std::pair<double, int> &a, const std::pair<double, int> &b) { return a.first > b.first; });
+
+    sample.resize(n);
+    for(int k = 0; k < n; k++) {
+        sample[k] = keys[k].second;
+    }
+}
+
+// position of the d-th point of the Hilbert curve filling a side x side
+// square, side being a power of two
+static void hilbert_point(int side, long d, int &x, int &y)
+{
+    x = 0;
+    y = 0;
+    for(int s = 1; s < side; s *= 2) {
+        int rx = 1 & (d / 2);
+        int ry = 1 & (d ^ rx);
+        if(ry == 0) {
+            if(rx == 1) {
+                x = s-1 - x;
+                y = s-1 - y;
+            }
+            std::swap(x, y);
+        }
+        x += s * rx;
+        y += s * ry;
+        d /= 4;
+    }
+}
+
+void sample_stratified(const std::vector< double > &weights, int width, int height, int n, std::mt19937 &rng, std::vector< int > &sample)
+{
+    int side = 1;
+    while(side < std::max(width, height)) side *= 2;
+
+    // pixels of positive density in the order of the curve
+    std::vector< int > order;
+    double total = 0.;
+    for(long d = 0; d < (long)side*side; d++) {
+        int x, y;
+        hilbert_point(side, d, x, y);
+        if(x >= width || y >= height) continue;
+        int id = y*width + x;
+        if(weights[id] <= 0) continue;
+        order.push_back(id);
+        total += weights[id];
+    }
+
+    int size = order.size();
+    n = std::min(n, width*height);
+    int nb_strata = std::min(n, size);
+    sample.clear();
+
+    std::vector< bool > occupied(width*height, false);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    double cumulated = 0.;
+    int position = 0;
+    // every pixel after the last one taken is free, and so is every pixel
+    // before the first free one once the end of the curve is reached
+    int last = -1, first_free = 0;
+    for(int k = 0; k < nb_strata; k++) {
+        // the draws increase with k, so the curve is walked once
+        double target = (k + uniform(rng)) * total / nb_strata;
+        while(position < size-1 && cumulated + weights[order[position]] < target) {
+            cumulated += weights[order[position]];
+            position++;
+        }
+
+        int p = std::max(position, last + 1);
+        if(p >= size) {
+            while(occupied[order[first_free]]) first_free++;
+            p = first_free;
+        } else {
+            last = p;
+        }
+        occupied[order[p]] = true;
+        sample.push_back(order[p]);
+    }
+
+    if(n == nb_strata) return;
+
+    // every pixel of positive density is taken, the others are drawn in
+    // random order
+    std::vector< int > rest;
+    for(int id = 0; id < width*height; id++) {
+        if(weights[id] <= 0) rest.push_back(id);
+    }
+    std::shuffle(rest.begin(), rest.end(), rng);
+    sample.insert(sample.end(), rest.begin(), rest.begin() + (n - nb_strata));
+}
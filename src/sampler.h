@@ -0,0 +1,42 @@
+#ifndef sampler_h_INCLUDED
+#define sampler_h_INCLUDED
+
+#include <vector>
+#include <random>
+
+/* Walker's alias table: draws an index i with probability proportional to
+   weights[i] in constant time, after a linear time construction */
+class AliasTable
+{
+    public:
+        AliasTable();
+        AliasTable(const std::vector< double > &weights);
+
+        void build(const std::vector< double > &weights);
+
+        int sample(std::mt19937 &rng) const;
+
+        int size() const { return probability.size(); }
+
+    private:
+        // the index i is kept with probability probability[i], and replaced
+        // by alias[i] otherwise
+        std::vector< double > probability;
+        std::vector< int > alias;
+};
+
+/* Draws n distinct indices, as successive draws proportional to weights
+   rejecting the indices already drawn would (Efraimidis and Spirakis'
+   exponential keys), in linear time. Indices of zero weight are only drawn,
+   in random order, once all the others are */
+void sample_without_replacement(const std::vector< double > &weights, int n, std::mt19937 &rng, std::vector< int > &sample);
+
+/* Draws n distinct pixels of a width x height grid from the density
+   weights (stored at y*width + x) with one uniform draw in each of n strata
+   of equal mass, taken along a Hilbert curve so that the strata are compact
+   and the pixels evenly spread. A pixel drawn twice is replaced by the next
+   free pixel of positive density along the curve. Pixels of zero density
+   are only drawn, in random order, once all the others are */
+void sample_stratified(const std::vector< double > &weights, int width, int height, int n, std::mt19937 &rng, std::vector< int > &sample);
+
+#endif // sampler_h_INCLUDED
@@ -0,0 +1,340 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "stb_image_write.h"
+
+#include "sequence_writer.h"
+
+#define GIF_MIN_CODE_SIZE 8
+#define GIF_CLEAR_CODE 256
+#define GIF_MAX_CODE 4095
+
+static unsigned int crc32(const unsigned char *data, unsigned int length, unsigned int crc = 0)
+{
+    static unsigned int table[256];
+    static bool initialised = false;
+    if(!initialised) {
+        for(unsigned int n = 0; n < 256; n++) {
+            unsigned int c = n;
+            for(int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        initialised = true;
+    }
+
+    crc = ~crc;
+    for(unsigned int i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put_u32_be(unsigned char *p, unsigned int v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static unsigned int get_u32_be(const unsigned char *p)
+{
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+static void put_u16_le(FILE *file, int v)
+{
+    fputc(v & 0xff, file);
+    fputc((v >> 8) & 0xff, file);
+}
+
+static void append_to_vector(void *context, void *data, int size)
+{
+    std::vector< unsigned char > *out = static_cast< std::vector< unsigned char >* >(context);
+    out->insert(out->end(), (unsigned char*)data, (unsigned char*)data + size);
+}
+
+bool parse_sequence_format(const std::string &name, SequenceFormat &format)
+{
+    if(name == "png") {
+        format = SEQUENCE_PNG;
+    } else if(name == "gif") {
+        format = SEQUENCE_GIF;
+    } else if(name == "apng") {
+        format = SEQUENCE_APNG;
+    } else if(name == "y4m") {
+        format = SEQUENCE_Y4M;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+SequenceWriter::SequenceWriter(SequenceFormat f, const std::string &output, int r)
+{
+    format = f;
+    fps = std::max(r, 1);
+    width = 0;
+    height = 0;
+    nb_frames = 0;
+    bit_buffer = 0;
+    bit_count = 0;
+    sequence_number = 0;
+    actl_position = -1;
+
+    if(output == "-") {
+        file = stdout;
+    } else {
+        file = fopen(output.c_str(), "wb");
+    }
+    if(file == NULL) {
+        std::cerr << "Cannot open " << output << " to write the sequence" << std::endl;
+    }
+    if(file == stdout && format == SEQUENCE_APNG) {
+        // the frame count is only known at the end and must be written back
+        std::cerr << "Animated PNGs cannot be streamed to the standard output" << std::endl;
+        file = NULL;
+    }
+}
+
+SequenceWriter::~SequenceWriter()
+{
+    if(file == NULL) return;
+
+    if(format == SEQUENCE_GIF && nb_frames > 0) {
+        fputc(0x3b, file);
+    } else if(format == SEQUENCE_APNG && nb_frames > 0) {
+        write_chunk("IEND", NULL, 0);
+
+        // patch the frame count of acTL, and its checksum
+        unsigned char actl[12];
+        memcpy(actl, "acTL", 4);
+        put_u32_be(actl + 4, nb_frames);
+        put_u32_be(actl + 8, 0);
+        unsigned char crc[4];
+        put_u32_be(crc, crc32(actl, 12));
+        fseek(file, actl_position, SEEK_SET);
+        fwrite(actl + 4, 1, 8, file);
+        fwrite(crc, 1, 4, file);
+    }
+
+    if(file == stdout) {
+        fflush(file);
+    } else {
+        fclose(file);
+    }
+}
+
+void SequenceWriter::append(const Image &frame)
+{
+    if(file == NULL) return;
+
+    if(nb_frames == 0) {
+        width = frame.width;
+        height = frame.height;
+        if(format == SEQUENCE_GIF) begin_gif();
+        if(format == SEQUENCE_Y4M) fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+    }
+    if(frame.width != width || frame.height != height) {
+        std::cerr << "Skipping a frame whose size differs from the sequence's" << std::endl;
+        return;
+    }
+
+    // only the first channel of the frames is written
+    const double *gray = frame.channel(0);
+    pixels.resize(width*height);
+    for(int id = 0; id < width*height; id++) {
+        pixels[id] = std::max(std::min((int)(255. * gray[id]), 255), 0);
+    }
+
+    if(format == SEQUENCE_GIF) {
+        append_gif();
+    } else if(format == SEQUENCE_APNG) {
+        append_apng();
+    } else if(format == SEQUENCE_Y4M) {
+        append_y4m();
+    }
+    nb_frames++;
+}
+
+void SequenceWriter::begin_gif()
+{
+    fwrite("GIF89a", 1, 6, file);
+    put_u16_le(file, width);
+    put_u16_le(file, height);
+    // global palette of 256 entries, shared by every frame
+    fputc(0xf7, file);
+    fputc(0, file);
+    fputc(0, file);
+    for(int g = 0; g < 256; g++) {
+        fputc(g, file);
+        fputc(g, file);
+        fputc(g, file);
+    }
+
+    // loop forever
+    const unsigned char loop[] = {0x21, 0xff, 0x0b, 'N','E','T','S','C','A','P','E','2','.','0', 0x03, 0x01, 0x00, 0x00, 0x00};
+    fwrite(loop, 1, sizeof(loop), file);
+
+    lzw_child.resize((GIF_MAX_CODE+1) * 256);
+}
+
+void SequenceWriter::write_code(int code, int code_size)
+{
+    bit_buffer |= (unsigned int)code << bit_count;
+    bit_count += code_size;
+    while(bit_count >= 8) {
+        block.push_back(bit_buffer & 0xff);
+        bit_buffer >>= 8;
+        bit_count -= 8;
+        if(block.size() == 255) flush_block();
+    }
+}
+
+void SequenceWriter::flush_block()
+{
+    if(block.empty()) return;
+    fputc(block.size(), file);
+    fwrite(&block[0], 1, block.size(), file);
+    block.clear();
+}
+
+void SequenceWriter::append_gif()
+{
+    // graphic control extension holding the delay, in hundredths of a second
+    int delay = std::max(1, (100 + fps/2) / fps);
+    const unsigned char control[] = {0x21, 0xf9, 0x04, 0x00, (unsigned char)(delay & 0xff), (unsigned char)(delay >> 8), 0x00, 0x00};
+    fwrite(control, 1, sizeof(control), file);
+
+    // image descriptor covering the screen, using the global palette
+    fputc(0x2c, file);
+    put_u16_le(file, 0);
+    put_u16_le(file, 0);
+    put_u16_le(file, width);
+    put_u16_le(file, height);
+    fputc(0, file);
+    fputc(GIF_MIN_CODE_SIZE, file);
+
+    std::fill(lzw_child.begin(), lzw_child.end(), -1);
+    int code_size = GIF_MIN_CODE_SIZE + 1;
+    int max_code = GIF_CLEAR_CODE + 1;
+    bit_buffer = 0;
+    bit_count = 0;
+    block.clear();
+
+    write_code(GIF_CLEAR_CODE, code_size);
+    int current = pixels[0];
+    for(int id = 1; id < width*height; id++) {
+        int next = pixels[id];
+        int child = lzw_child[current*256 + next];
+        if(child >= 0) {
+            current = child;
+            continue;
+        }
+
+        write_code(current, code_size);
+        lzw_child[current*256 + next] = ++max_code;
+        if(max_code >= (1 << code_size)) code_size++;
+        if(max_code == GIF_MAX_CODE) {
+            write_code(GIF_CLEAR_CODE, code_size);
+            std::fill(lzw_child.begin(), lzw_child.end(), -1);
+            code_size = GIF_MIN_CODE_SIZE + 1;
+            max_code = GIF_CLEAR_CODE + 1;
+        }
+        current = next;
+    }
+    write_code(current, code_size);
+    write_code(GIF_CLEAR_CODE, code_size);
+    write_code(GIF_CLEAR_CODE + 1, GIF_MIN_CODE_SIZE + 1);
+    if(bit_count > 0) write_code(0, 8 - bit_count);
+    flush_block();
+    fputc(0, file);
+}
+
+void SequenceWriter::write_chunk(const char *type, const unsigned char *data, unsigned int length)
+{
+    unsigned char header[8];
+    put_u32_be(header, length);
+    memcpy(header + 4, type, 4);
+    unsigned char crc[4];
+    put_u32_be(crc, crc32(data, length, crc32(header + 4, 4)));
+
+    fwrite(header, 1, 8, file);
+    if(length > 0) fwrite(data, 1, length, file);
+    fwrite(crc, 1, 4, file);
+}
+
+void SequenceWriter::append_apng()
+{
+    png.clear();
+    stbi_write_png_to_func(append_to_vector, &png, width, height, 1, &pixels[0], width);
+
+    if(nb_frames == 0) {
+        const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        fwrite(signature, 1, 8, file);
+    }
+
+    // frame control: full frame, delay of 1/fps, no disposal nor blending
+    unsigned char control[26];
+    put_u32_be(control, sequence_number++);
+    put_u32_be(control + 4, width);
+    put_u32_be(control + 8, height);
+    put_u32_be(control + 12, 0);
+    put_u32_be(control + 16, 0);
+    control[20] = 0;
+    control[21] = 1;
+    control[22] = fps >> 8;
+    control[23] = fps & 0xff;
+    control[24] = 0;
+    control[25] = 0;
+
+    // walk the chunks of the encoded PNG, after its signature
+    bool control_written = false;
+    std::vector< unsigned char > data;
+    for(size_t p = 8; p + 12 <= png.size(); ) {
+        unsigned int length = get_u32_be(&png[p]);
+        const char *type = (const char*)&png[p+4];
+        const unsigned char *content = &png[p+8];
+
+        if(nb_frames == 0 && memcmp(type, "IHDR", 4) == 0) {
+            write_chunk("IHDR", content, length);
+            // the frame count is written back once known
+            unsigned char animation[8];
+            put_u32_be(animation, 0);
+            put_u32_be(animation + 4, 0);
+            actl_position = ftell(file) + 8;
+            write_chunk("acTL", animation, 8);
+        } else if(memcmp(type, "IDAT", 4) == 0) {
+            if(!control_written) {
+                write_chunk("fcTL", control, 26);
+                control_written = true;
+            }
+            if(nb_frames == 0) {
+                write_chunk("IDAT", content, length);
+            } else {
+                data.resize(length + 4);
+                put_u32_be(&data[0], sequence_number++);
+                if(length > 0) memcpy(&data[4], content, length);
+                write_chunk("fdAT", &data[0], length + 4);
+            }
+        }
+        p += length + 12;
+    }
+}
+
+void SequenceWriter::append_y4m()
+{
+    fwrite("FRAME\n", 1, 6, file);
+    fwrite(&pixels[0], 1, width*height, file);
+
+    // neutral chroma
+    int chroma = ((width+1)/2) * ((height+1)/2);
+    pixels.assign(2*chroma, 128);
+    fwrite(&pixels[0], 1, 2*chroma, file);
+}
@@ -0,0 +1,74 @@
+#ifndef sequence_writer_h_INCLUDED
+#define sequence_writer_h_INCLUDED
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "image.h"
+
+enum SequenceFormat
+{
+    // one PNG file per frame, through the ImageWriter
+    SEQUENCE_PNG,
+    // animated GIF with a single gray palette shared by all frames
+    SEQUENCE_GIF,
+    // animated PNG, the output must be a regular file
+    SEQUENCE_APNG,
+    // raw YUV4MPEG2 video, typically piped into an encoder
+    SEQUENCE_Y4M
+};
+
+/* Parses "png", "gif", "apng" or "y4m", returns false for other names */
+bool parse_sequence_format(const std::string &name, SequenceFormat &format);
+
+/* Appends gray frames of a fixed size to an animation as they are
+   produced, without intermediate files; the output "-" is the standard
+   output. The animation is completed when the writer is destroyed */
+class SequenceWriter
+{
+    public:
+        SequenceWriter(SequenceFormat format, const std::string &output, int fps);
+        ~SequenceWriter();
+
+        bool is_open() const { return file != NULL; }
+
+        void append(const Image &frame);
+
+    private:
+        SequenceFormat format;
+        FILE *file;
+        int fps;
+        int width;
+        int height;
+        int nb_frames;
+        std::vector< unsigned char > pixels;
+
+        // GIF: LZW code of the string made of a code followed by a byte,
+        // stored at code*256 + byte (-1 when absent), and the bit packing
+        std::vector< short > lzw_child;
+        std::vector< unsigned char > block;
+        unsigned int bit_buffer;
+        int bit_count;
+
+        // APNG: the encoded frame, the sequence number of the next chunk
+        // and where the frame count of the acTL chunk lies in the file
+        std::vector< unsigned char > png;
+        unsigned int sequence_number;
+        long actl_position;
+
+        void begin_gif();
+        void append_gif();
+        void write_code(int code, int code_size);
+        void flush_block();
+
+        void append_apng();
+        void write_chunk(const char *type, const unsigned char *data, unsigned int length);
+
+        void append_y4m();
+
+        SequenceWriter(const SequenceWriter &);
+        SequenceWriter &operator=(const SequenceWriter &);
+};
+
+#endif // sequence_writer_h_INCLUDED
@@ -0,0 +1,231 @@
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+
+#include "image.h"
+#include "power_diagram.h"
+#include "mapping.h"
+
+#include "transport.h"
+
+SparseMatrix::SparseMatrix()
+{
+    size = 0;
+}
+
+void SparseMatrix::multiply(const std::vector<double> &x, std::vector<double> &y) const
+{
+    y.resize(size);
+    for(int i = 0; i < size; i++) {
+        double sum = diagonal[i] * x[i];
+        for(int k = row_offset[i]; k < row_offset[i+1]; k++) {
+            sum -= values[k] * x[columns[k]];
+        }
+        y[i] = sum;
+    }
+}
+
+// integral of the gray level along the segment [a, b], sampled at least
+// once per pixel at the nearest pixel
+static double segment_mass(const Image &image, const std::pair<double, double> &a, const std::pair<double, double> &b)
+{
+    double dx = b.first - a.first;
+    double dy = b.second - a.second;
+    double length = sqrt(dx*dx + dy*dy);
+    int nb_samples = std::max(1, (int)ceil(length));
+
+    double mass = 0.;
+    for(int k = 0; k < nb_samples; k++) {
+        double t = (k + 0.5) / nb_samples;
+        int x = std::min(std::max((int)floor(a.first + t*dx + 0.5), 0), image.width-1);
+        int y = std::min(std::max((int)floor(a.second + t*dy + 0.5), 0), image.height-1);
+        mass += image.gs(x, y);
+    }
+    return mass * length / nb_samples;
+}
+
+void assemble_mass_hessian(const Image &image, const PowerDiagram &pd, SparseMatrix &hessian)
+{
+    int N = pd.nb_sites;
+    hessian.size = N;
+    hessian.diagonal.assign(N, 0.);
+    hessian.row_offset.assign(N+1, 0);
+
+    // each boundary is measured once, from the cell of its smallest site
+    std::vector< std::pair<int, int> > &pairs = hessian.pairs;
+    std::vector< double > &pair_values = hessian.pair_values;
+    pairs.clear();
+    pair_values.clear();
+    for(int i = 0; i < N; i++) {
+        const std::vector< std::pair<double, double> > &polygon = pd.sites_edges[i];
+        int nb_vertices = polygon.size();
+        for(int k = 0; k < nb_vertices; k++) {
+            int j = pd.sites_neighbors[i][k];
+            if(j <= i) continue;
+
+            double dx = pd.sites[j].first - pd.sites[i].first;
+            double dy = pd.sites[j].second - pd.sites[i].second;
+            double value = segment_mass(image, polygon[k], polygon[(k+1) % nb_vertices]) / (2*sqrt(dx*dx + dy*dy));
+            if(value <= 0) continue;
+
+            pairs.push_back(std::make_pair(i, j));
+            pair_values.push_back(value);
+            hessian.row_offset[i+1]++;
+            hessian.row_offset[j+1]++;
+            hessian.diagonal[i] += value;
+            hessian.diagonal[j] += value;
+        }
+    }
+
+    for(int i = 0; i < N; i++) {
+        hessian.row_offset[i+1] += hessian.row_offset[i];
+    }
+
+    hessian.columns.resize(hessian.row_offset[N]);
+    hessian.values.resize(hessian.row_offset[N]);
+    std::vector< int > &cursor = hessian.cursor;
+    cursor.assign(hessian.row_offset.begin(), hessian.row_offset.end() - 1);
+    for(int p = 0; p < (int)pairs.size(); p++) {
+        int i = pairs[p].first, j = pairs[p].second;
+        hessian.columns[cursor[i]] = j;
+        hessian.values[cursor[i]++] = pair_values[p];
+        hessian.columns[cursor[j]] = i;
+        hessian.values[cursor[j]++] = pair_values[p];
+    }
+}
+
+static double dot(const std::vector<double> &a, const std::vector<double> &b)
+{
+    double sum = 0.;
+    for(int i = 0; i < (int)a.size(); i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+int conjugate_gradient(const SparseMatrix &A, const std::vector<double> &rhs, std::vector<double> &x, double tolerance, int max_iter,
+                       ConjugateGradientWorkspace &cg)
+{
+    int n = A.size;
+    x.resize(n, 0.);
+
+    std::vector<double> &b = cg.b, &inv_diagonal = cg.inv_diagonal;
+    std::vector<double> &r = cg.r, &z = cg.z, &p = cg.p, &Ap = cg.Ap;
+    b.assign(rhs.begin(), rhs.end());
+    inv_diagonal.resize(n);
+    r.resize(n);
+    z.resize(n);
+    Ap.resize(n);
+
+    // sites with an empty cell have an empty row, they get a diagonal of
+    // the typical magnitude so that their weight still moves
+    double typical = 0.;
+    int nb_nonzero = 0;
+    for(int i = 0; i < n; i++) {
+        if(A.diagonal[i] > 0) {
+            typical += A.diagonal[i];
+            nb_nonzero++;
+        }
+    }
+    typical = (nb_nonzero > 0) ? typical / nb_nonzero : 1.;
+
+    // the projection only involves the coupled rows, the others not being
+    // part of the system solved
+    double mean = 0.;
+    for(int i = 0; i < n; i++) {
+        if(A.diagonal[i] > 0) mean += b[i] / nb_nonzero;
+    }
+    for(int i = 0; i < n; i++) {
+        if(A.diagonal[i] > 0) b[i] -= mean;
+    }
+
+    for(int i = 0; i < n; i++) {
+        inv_diagonal[i] = 1. / (A.diagonal[i] > 0 ? A.diagonal[i] : typical);
+    }
+
+    A.multiply(x, Ap);
+    for(int i = 0; i < n; i++) {
+        r[i] = b[i] - Ap[i];
+        if(A.diagonal[i] <= 0) r[i] = 0.;
+        z[i] = inv_diagonal[i] * r[i];
+    }
+    p = z;
+
+    double b_norm = sqrt(dot(b, b));
+    double rz = dot(r, z);
+    int iter = 0;
+    for(; iter < max_iter && sqrt(dot(r, r)) > tolerance * b_norm; iter++) {
+        A.multiply(p, Ap);
+        double pAp = dot(p, Ap);
+        if(pAp <= 0) break;
+
+        double alpha = rz / pAp;
+        for(int i = 0; i < n; i++) {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * Ap[i];
+            z[i] = inv_diagonal[i] * r[i];
+        }
+
+        double rz_next = dot(r, z);
+        double beta = rz_next / rz;
+        rz = rz_next;
+        for(int i = 0; i < n; i++) {
+            p[i] = z[i] + beta * p[i];
+        }
+    }
+
+    // empty cells are not coupled to the others, move them on their own
+    for(int i = 0; i < n; i++) {
+        if(A.diagonal[i] <= 0) x[i] = inv_diagonal[i] * b[i];
+    }
+
+    return iter;
+}
+
+bool newton_step(const Image &image, const std::vector<double> &target_masses, double min_mass,
+                 PowerDiagram *&pd, PowerDiagram *&trial, MappingWorkspace &ws, NewtonWorkspace &newton, std::vector<double> &masses)
+{
+    int N = pd->nb_sites;
+
+    std::vector<double> &rhs = newton.rhs;
+    std::vector<double> &direction = newton.direction;
+    std::vector<double> &trial_weights = newton.trial_weights;
+    rhs.resize(N);
+    direction.assign(N, 0.);
+    trial_weights.resize(N);
+
+    double norm = 0;
+    for(int p = 0; p < N; p++) {
+        rhs[p] = target_masses[p] - masses[p];
+        norm += rhs[p]*rhs[p];
+    }
+    norm = sqrt(norm);
+
+    assemble_mass_hessian(image, *pd, newton.hessian);
+    conjugate_gradient(newton.hessian, rhs, direction, 1e-6, 1000, newton.cg);
+
+    for(double alpha = 1.; alpha >= 1./1024; alpha /= 2) {
+        for(int p = 0; p < N; p++) {
+            trial_weights[p] = pd->weights[p] + alpha*direction[p];
+        }
+
+        trial->update_weights(trial_weights);
+        generate_mapping(image, *trial, ws, MAPPING_MASSES | MAPPING_INCREMENTAL);
+
+        double trial_norm = 0, trial_min_mass = ws.site_weight[0];
+        for(int p = 0; p < N; p++) {
+            double g = target_masses[p] - ws.site_weight[p];
+            trial_norm += g*g;
+            trial_min_mass = std::min(trial_min_mass, ws.site_weight[p]);
+        }
+
+        if(trial_min_mass >= min_mass && sqrt(trial_norm) <= (1 - alpha/2) * norm) {
+            std::swap(pd, trial);
+            masses = ws.site_weight;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,81 @@
+#ifndef transport_h_INCLUDED
+#define transport_h_INCLUDED
+
+#include <vector>
+#include <utility>
+
+#include "image.h"
+#include "power_diagram.h"
+#include "mapping.h"
+
+/* Symmetric sparse matrix of the form diagonal - off-diagonal entries, as
+   the Hessian of the cell masses with respect to the weights is */
+class SparseMatrix
+{
+    public:
+        int size;
+        std::vector< double > diagonal;
+        // off-diagonal entries of the row i are
+        // -values[k] at column columns[k], for row_offset[i] <= k < row_offset[i+1]
+        std::vector< int > row_offset;
+        std::vector< int > columns;
+        std::vector< double > values;
+
+        // scratch buffers of assemble_mass_hessian: the boundaries (i, j),
+        // i < j, their values, and the insertion cursor of each row
+        std::vector< std::pair<int, int> > pairs;
+        std::vector< double > pair_values;
+        std::vector< int > cursor;
+
+        SparseMatrix();
+
+        void multiply(const std::vector<double> &x, std::vector<double> &y) const;
+};
+
+/* Assembles the derivative of the masses of the cells of pd (measured in
+   image) with respect to the weights: moving the weight of i by dw moves
+   the boundary shared with j by dw/(2|s_i - s_j|), so the (i, j) entry is
+   minus the mass of that boundary over 2|s_i - s_j| */
+void assemble_mass_hessian(const Image &image, const PowerDiagram &pd, SparseMatrix &hessian);
+
+/* Buffers of conjugate_gradient: the projected right-hand side, the inverse
+   of the preconditioner, and the residual, preconditioned residual, search
+   direction and its product by the matrix */
+struct ConjugateGradientWorkspace
+{
+    std::vector< double > b;
+    std::vector< double > inv_diagonal;
+    std::vector< double > r;
+    std::vector< double > z;
+    std::vector< double > p;
+    std::vector< double > Ap;
+};
+
+/* Solves A x = b with a Jacobi preconditioned conjugate gradient, starting
+   from x; b is projected on the range of A (zero mean) first since the
+   masses do not change when all the weights move together. Returns the
+   number of iterations performed */
+int conjugate_gradient(const SparseMatrix &A, const std::vector<double> &b, std::vector<double> &x, double tolerance, int max_iter,
+                       ConjugateGradientWorkspace &cg);
+
+/* Buffers of newton_step, sized by the first step and reused by the next
+   ones, so that the steps do not allocate */
+struct NewtonWorkspace
+{
+    SparseMatrix hessian;
+    ConjugateGradientWorkspace cg;
+    std::vector< double > rhs;
+    std::vector< double > direction;
+    std::vector< double > trial_weights;
+};
+
+/* Damped Newton step on the weights of pd, whose cells hold masses (measured
+   in image) and should hold target_masses: the direction solves
+   H d = target_masses - masses, and the step is halved until no cell gets
+   lighter than min_mass and the residual decreases enough. The accepted
+   diagram is swapped into pd, and ws and masses then describe it; returns
+   false when no step decreases the residual */
+bool newton_step(const Image &image, const std::vector<double> &target_masses, double min_mass,
+                 PowerDiagram *&pd, PowerDiagram *&trial, MappingWorkspace &ws, NewtonWorkspace &newton, std::vector<double> &masses);
+
+#endif // transport_h_INCLUDED